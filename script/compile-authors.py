@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""
+Compile a stage author list (authors.str) into authors.bin, which the mod loads at boot instead of parsing authors.str.
+
+Usage: compile-authors.py [authors.str] [authors.bin]
+
+Place authors.bin next to authors.str in /stgname on the disc. authors.str stays the file to edit: re-run this after
+every edit. The mod compares authors.str's length against the one authors.bin was compiled from, and only falls back to
+parsing authors.str when authors.bin is missing or stale. An edit which keeps authors.str the same length goes
+unnoticed, so don't skip recompiling. authors.bin can also be shipped without authors.str.
+
+authors.str has one author name per line, the first line being stage ID 0. Stages past the last line have no author.
+Names are read the way the mod reads them: a name ends at a NUL or after 127 characters, and lines past the 421st are
+ignored.
+
+Format (big-endian, see map_compiled_authors() in src/patches/extensions/stage_author_names.cpp):
+    Header:
+        u32 magic                  'WSAU'
+        u16 version
+        u16 stage_count            Always 421
+        u32 size                   Size of the whole file
+        u32 checksum               FNV-1a of everything after the header
+        u32 text_length            Length of the authors.str this was compiled from
+    u16 name_offsets[421]          Offset of each stage's author name in the string pool, or 0xFFFF for none
+    String pool of NUL-terminated author names, each name stored once
+"""
+
+import struct
+import sys
+
+MAGIC = b"WSAU"
+VERSION = 3
+STAGE_ID_COUNT = 421
+MAX_NAME_LENGTH = 127
+NO_AUTHOR = 0xFFFF
+
+
+def fnv1a(data):
+    h = 0x811C9DC5
+    for b in data:
+        h = ((h ^ b) * 0x01000193) & 0xFFFFFFFF
+    return h
+
+
+def warn(src, message):
+    print(f"{src}:{message}", file=sys.stderr)
+
+
+def parse(text_bytes, src):
+    # Split like the mod does, so both read the same names out of a file
+    lines = text_bytes.split(b"\n") if text_bytes else []
+    if text_bytes.endswith(b"\n"):
+        lines.pop()
+    if len(lines) > STAGE_ID_COUNT:
+        warn(src, f"{STAGE_ID_COUNT + 1}: Lines past line {STAGE_ID_COUNT} are ignored")
+        del lines[STAGE_ID_COUNT:]
+
+    names = []
+    for line_number, line in enumerate(lines, 1):
+        name = line[:-1] if line.endswith(b"\r") else line
+        if b"\0" in name:
+            warn(src, f"{line_number}: Author name is cut short at a NUL character")
+            name = name[:name.index(b"\0")]
+        if len(name) > MAX_NAME_LENGTH:
+            warn(src, f"{line_number}: Author name is cut short to {MAX_NAME_LENGTH} characters")
+            name = name[:MAX_NAME_LENGTH]
+        names.append(name)
+    return names
+
+
+def compile_authors(text_bytes, src):
+    names = parse(text_bytes, src)
+
+    pool = bytearray()
+    pool_offsets = {}
+    name_offsets = [NO_AUTHOR] * STAGE_ID_COUNT
+    for stage_id, name in enumerate(names):
+        if name not in pool_offsets:
+            pool_offsets[name] = len(pool)
+            pool += name + b"\0"
+        name_offsets[stage_id] = pool_offsets[name]
+    # At most 421 names of 128 bytes each, so offsets always fit
+    assert len(pool) < NO_AUTHOR
+
+    body = struct.pack(f">{STAGE_ID_COUNT}H", *name_offsets) + pool
+
+    header_size = 20
+    size = header_size + len(body)
+    header = struct.pack(">4sHHIII", MAGIC, VERSION, STAGE_ID_COUNT, size, fnv1a(body), len(text_bytes))
+    assert len(header) == header_size
+    return header + body
+
+
+def main():
+    src = sys.argv[1] if len(sys.argv) > 1 else "authors.str"
+    dst = sys.argv[2] if len(sys.argv) > 2 else "authors.bin"
+
+    with open(src, "rb") as f:
+        text_bytes = f.read()
+    blob = compile_authors(text_bytes, src)
+    with open(dst, "wb") as f:
+        f.write(blob)
+    print(f"Compiled {src} into {dst} ({len(blob)} bytes)")
+
+
+if __name__ == "__main__":
+    main()
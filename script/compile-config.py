@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+"""
+Compile a Workshop Mod config.txt into config.bin, which the mod loads at boot instead of parsing config.txt.
+
+Usage: compile-config.py [--little-endian] [config.txt] [config.bin]
+
+Place config.bin next to config.txt on the disc. config.txt stays the file to edit: re-run this after every edit. The
+mod compares config.txt's length against the one config.bin was compiled from, and only falls back to parsing
+config.txt when config.bin is missing or stale. An edit which keeps config.txt the same length goes unnoticed, so
+don't skip recompiling. config.bin can also be shipped without config.txt.
+
+Format (big-endian, or little-endian for host tests, see parse_compiled() in src/config/config_parser.cpp):
+    Header:
+        u32 magic                  'WSCF'
+        u16 version
+        u16 patch_count
+        u32 size                   Size of the whole file
+        u32 checksum               FNV-1a of everything after the header
+        u32 text_length            Length of the config.txt this was compiled from
+        u16 party_game_bitflag
+        u16 padding
+    PatchEntry[patch_count], sorted by name:
+        u16 name_offset            Offset of the name in the string table
+        u8 state                   0: disabled, 1: enabled, 2: value
+        u8 padding
+        s32 value
+    u16 theme_ids[421]
+    u16 music_ids[421]
+    String table of NUL-terminated patch names
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+MAGIC = b"WSCF"
+VERSION = 5
+STAGE_ID_COUNT = 421
+
+STATE_DISABLED = 0
+STATE_ENABLED = 1
+STATE_VALUE = 2
+
+PARTY_GAMES = {
+    "monkey-race": 0x1,
+    "monkey-fight": 0x2,
+    "monkey-target": 0x4,
+    "monkey-billiards": 0x8,
+    "monkey-bowling": 0x10,
+    "monkey-golf": 0x20,
+    "monkey-boat": 0x40,
+    "monkey-shot": 0x80,
+    "monkey-dogfight": 0x100,
+    "monkey-soccer": 0x200,
+    "monkey-baseball": 0x400,
+    "monkey-tennis": 0x800,
+}
+
+
+class ConfigError(Exception):
+    pass
+
+
+def fnv1a(data):
+    h = 0x811C9DC5
+    for b in data:
+        h = ((h ^ b) * 0x01000193) & 0xFFFFFFFF
+    return h
+
+
+def parse(text):
+    patches = {}
+    party_game_bitflag = 0
+    theme_ids = [0] * STAGE_ID_COUNT
+    music_ids = [0] * STAGE_ID_COUNT
+
+    section = None
+    for line_number, line in enumerate(text.splitlines(), 1):
+        stripped = line.strip()
+
+        # Anything outside of a section is a comment
+        if section is None:
+            if line.startswith("#") and "{" in line:
+                section = line[1:line.index("{")].strip()
+            continue
+
+        if not stripped:
+            continue
+        if stripped.startswith("}"):
+            section = None
+            continue
+        if section not in ("REL Patches", "Party Game Toggles", "Theme IDs", "Music IDs"):
+            continue
+
+        if ":" not in stripped:
+            raise ConfigError(f"{line_number}: Expected ':' after key")
+        key, value = (s.strip() for s in stripped.split(":", 1))
+        if not key or not value:
+            raise ConfigError(f"{line_number}: Expected a key and a value")
+
+        if section == "REL Patches":
+            if value == "enabled":
+                patches[key] = (STATE_ENABLED, 0)
+            elif value == "disabled":
+                patches[key] = (STATE_DISABLED, 0)
+            else:
+                patches[key] = (STATE_VALUE, parse_int(value, line_number))
+
+        elif section == "Party Game Toggles":
+            if key not in PARTY_GAMES:
+                raise ConfigError(f"{line_number}: Unknown party game {key}")
+            if value == "enabled":
+                party_game_bitflag |= PARTY_GAMES[key]
+            elif value != "disabled":
+                raise ConfigError(f"{line_number}: Expected 'enabled' or 'disabled'")
+
+        else:
+            if not key.startswith("STAGE "):
+                raise ConfigError(f"{line_number}: Expected a key like 'STAGE 12'")
+            stage_id = parse_int(key[len("STAGE "):], line_number)
+            if not 0 <= stage_id < STAGE_ID_COUNT:
+                raise ConfigError(f"{line_number}: Stage ID out of range")
+            table = theme_ids if section == "Theme IDs" else music_ids
+            table[stage_id] = parse_int(value, line_number) & 0xFFFF
+
+    return patches, party_game_bitflag, theme_ids, music_ids
+
+
+def parse_int(s, line_number):
+    # Stricter than int(), which also takes "+5" and "1_000", unlike the mod
+    if not re.fullmatch(r"-?[0-9]+", s):
+        raise ConfigError(f"{line_number}: Expected a decimal integer")
+    return int(s, 10)
+
+
+def compile_config(text_bytes, byte_order=">"):
+    patches, party_game_bitflag, theme_ids, music_ids = parse(text_bytes.decode("ascii"))
+
+    # Sort by byte value, like strcmp on the console
+    names = sorted(patches, key=lambda name: name.encode("ascii"))
+    strings = bytearray()
+    entries = bytearray()
+    for name in names:
+        state, value = patches[name]
+        entries += struct.pack(f"{byte_order}HBxi", len(strings), state, value)
+        strings += name.encode("ascii") + b"\0"
+
+    body = entries
+    body += struct.pack(f"{byte_order}{STAGE_ID_COUNT}H", *theme_ids)
+    body += struct.pack(f"{byte_order}{STAGE_ID_COUNT}H", *music_ids)
+    body += strings
+
+    header_size = 24
+    size = header_size + len(body)
+    # The magic is read as a u32, so it's swapped along with everything else
+    magic = int.from_bytes(MAGIC, "big")
+    header = struct.pack(f"{byte_order}IHHIIIHxx", magic, VERSION, len(names), size, fnv1a(body), len(text_bytes),
+                         party_game_bitflag)
+    assert len(header) == header_size
+    return header + body
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile a Workshop Mod config.txt into config.bin")
+    parser.add_argument("src", nargs="?", default="config.txt")
+    parser.add_argument("dst", nargs="?", default="config.bin")
+    parser.add_argument("--little-endian", action="store_true",
+                        help="for host tests, rather than the console")
+    args = parser.parse_args()
+    src = args.src
+    dst = args.dst
+
+    with open(src, "rb") as f:
+        text_bytes = f.read()
+    try:
+        blob = compile_config(text_bytes, "<" if args.little_endian else ">")
+    except ConfigError as e:
+        sys.exit(f"{src}:{e}")
+    with open(dst, "wb") as f:
+        f.write(blob)
+    print(f"Compiled {src} into {dst} ({len(blob)} bytes)")
+
+
+if __name__ == "__main__":
+    main()
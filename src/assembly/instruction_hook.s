@@ -0,0 +1,72 @@
+.global instruction_hook_common
+
+# Shared part of every patch::hook_instruction() stub. The per-hook stub allocates the stack frame, saves r0 and lr
+# into the context, and calls this with the hook in r0. Layout of the 0x110 byte frame:
+#   0x000  back chain
+#   0x004  lr save word for the callback
+#   0x008  patch::CpuContext: gpr[32], fpr[14] (f0-f13), cr, xer, ctr, lr
+#   0x108  return address into the stub
+#   0x10c  hook
+# Everything in the context is restored afterwards, so the callback can change any register except sp.
+
+instruction_hook_common:
+    stw r0, 0x10c(sp)
+    mflr r0
+    stw r0, 0x108(sp)
+
+    stmw r2, 0x10(sp)               # gpr[2] to gpr[31]
+    addi r0, sp, 0x110
+    stw r0, 0xc(sp)                 # gpr[1], sp at the hooked instruction
+    stfd f0, 0x88(sp)
+    stfd f1, 0x90(sp)
+    stfd f2, 0x98(sp)
+    stfd f3, 0xa0(sp)
+    stfd f4, 0xa8(sp)
+    stfd f5, 0xb0(sp)
+    stfd f6, 0xb8(sp)
+    stfd f7, 0xc0(sp)
+    stfd f8, 0xc8(sp)
+    stfd f9, 0xd0(sp)
+    stfd f10, 0xd8(sp)
+    stfd f11, 0xe0(sp)
+    stfd f12, 0xe8(sp)
+    stfd f13, 0xf0(sp)
+    mfcr r0
+    stw r0, 0xf8(sp)
+    mfxer r0
+    stw r0, 0xfc(sp)
+    mfctr r0
+    stw r0, 0x100(sp)
+
+    lwz r12, 0x10c(sp)              # The callback is the hook's first member
+    lwz r12, 0(r12)
+    mtctr r12
+    addi r3, sp, 0x8
+    bctrl
+
+    lwz r0, 0xf8(sp)
+    mtcr r0
+    lwz r0, 0xfc(sp)
+    mtxer r0
+    lwz r0, 0x100(sp)
+    mtctr r0
+    lfd f0, 0x88(sp)
+    lfd f1, 0x90(sp)
+    lfd f2, 0x98(sp)
+    lfd f3, 0xa0(sp)
+    lfd f4, 0xa8(sp)
+    lfd f5, 0xb0(sp)
+    lfd f6, 0xb8(sp)
+    lfd f7, 0xc0(sp)
+    lfd f8, 0xc8(sp)
+    lfd f9, 0xd0(sp)
+    lfd f10, 0xd8(sp)
+    lfd f11, 0xe0(sp)
+    lfd f12, 0xe8(sp)
+    lfd f13, 0xf0(sp)
+    lmw r2, 0x10(sp)
+
+    # The stub restores r0, lr and sp, then runs the hooked instruction
+    lwz r0, 0x108(sp)
+    mtlr r0
+    blr
@@ -0,0 +1,451 @@
+#include "config_parser.h"
+
+#include "internal/assembly.h"
+#include "internal/tickable.h"
+#include "patches/custom/party_game_toggle.h"
+#include "utils/hashutil.h"
+
+#define STREQ(x, y) (mkb::strcmp(const_cast<char*>(x), const_cast<char*>(y)) == 0)
+
+namespace config {
+
+// Longer lines are truncated, which only ever happens to comments
+static constexpr u32 LINE_SIZE = 128;
+
+// Stage ID lists map every stage ID to something
+static constexpr u32 STAGE_ID_COUNT = sizeof(main::theme_id_lookup) / sizeof(main::theme_id_lookup[0]);
+
+enum class Section {
+    None,
+    RelPatches,
+    PartyGameToggles,
+    ThemeIds,
+    DifficultyLayout,
+    MusicIds,
+    Unknown,
+};
+
+template<typename T>
+struct KeyEntry {
+    const char* key;
+    T value;
+};
+
+/*
+ * Key tables must be sorted by key, so keys can be looked up with a binary search
+ */
+
+static constexpr KeyEntry<Section> SECTIONS[] = {
+    {"Difficulty Layout", Section::DifficultyLayout},
+    {"Music IDs", Section::MusicIds},
+    {"Party Game Toggles", Section::PartyGameToggles},
+    {"REL Patches", Section::RelPatches},
+    {"Theme IDs", Section::ThemeIds},
+};
+
+static constexpr KeyEntry<u16> PARTY_GAMES[] = {
+    {"monkey-baseball", 0x400},
+    {"monkey-billiards", 0x8},
+    {"monkey-boat", 0x40},
+    {"monkey-bowling", 0x10},
+    {"monkey-dogfight", 0x100},
+    {"monkey-fight", 0x2},
+    {"monkey-golf", 0x20},
+    {"monkey-race", 0x1},
+    {"monkey-shot", 0x80},
+    {"monkey-soccer", 0x200},
+    {"monkey-target", 0x4},
+    {"monkey-tennis", 0x800},
+};
+
+static constexpr s32 constexpr_strcmp(const char* a, const char* b) {
+    while (*a != '\0' && *a == *b) {
+        a++;
+        b++;
+    }
+    return static_cast<u8>(*a) - static_cast<u8>(*b);
+}
+
+template<typename T, u32 N>
+static constexpr bool is_sorted(const KeyEntry<T> (&table)[N]) {
+    for (u32 i = 1; i < N; i++) {
+        if (constexpr_strcmp(table[i - 1].key, table[i].key) >= 0) return false;
+    }
+    return true;
+}
+
+static_assert(is_sorted(SECTIONS));
+static_assert(is_sorted(PARTY_GAMES));
+
+template<typename T, u32 N>
+static const KeyEntry<T>* lookup(const KeyEntry<T> (&table)[N], const char* key) {
+    u32 lo = 0;
+    u32 hi = N;
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        s32 cmp = mkb::strcmp(const_cast<char*>(table[mid].key), const_cast<char*>(key));
+        if (cmp == 0) return &table[mid];
+        if (cmp < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return nullptr;
+}
+
+/*
+ * config.bin, compiled offline from config.txt by script/compile-config.py
+ */
+
+static constexpr u32 COMPILED_MAGIC = 0x57534346;// 'WSCF'
+static constexpr u16 COMPILED_VERSION = 5;
+
+struct CompiledHeader {
+    u32 magic;
+    u16 version;
+    u16 patch_count;
+    u32 size;
+    u32 checksum;   // FNV-1a of everything after the header
+    u32 text_length;// Of the config.txt it was compiled from, to catch stale files
+    u16 party_game_bitflag;
+    u16 padding;
+};
+static_assert(sizeof(CompiledHeader) == 24);
+
+struct CompiledPatch {
+    static constexpr u8 DISABLED = 0;
+    static constexpr u8 ENABLED = 1;
+    static constexpr u8 VALUE = 2;
+
+    u16 name_offset;
+    u8 state;
+    u8 padding;
+    s32 value;
+};
+static_assert(sizeof(CompiledPatch) == 8);
+
+static Section s_section;
+static char s_line[LINE_SIZE];
+static u32 s_line_length;
+static u32 s_line_number;
+
+// Report a problem with the config at the given position in the current line, which is then skipped
+static void report_error(const char* at, const char* msg) {
+    mkb::OSReport("[wsmod] config.txt:%d:%d: %s\n", s_line_number, at - s_line + 1, msg);
+}
+
+struct KeyValue {
+    char* key;
+    char* value;
+};
+
+// Split a "key: value" line into its key and value in place, in a single pass. Leading and trailing whitespace is
+// ignored, so keys can be indented with tabs or spaces.
+static bool lex_key_value(char* line, KeyValue& out) {
+    char* c = line;
+    while (*c == '\t' || *c == ' ') c++;
+    out.key = c;
+
+    char* key_end = nullptr;
+    char* last_non_space = nullptr;
+    for (; *c != '\0'; c++) {
+        if (*c == ':' && !key_end) {
+            key_end = last_non_space ? last_non_space + 1 : c;
+            c++;
+            while (*c == '\t' || *c == ' ') c++;
+            out.value = c;
+            last_non_space = nullptr;
+            if (*c == '\0') break;
+        }
+        if (*c != '\t' && *c != ' ') {
+            last_non_space = c;
+        }
+    }
+
+    if (!key_end) {
+        report_error(c, "Expected ':' after key");
+        return false;
+    }
+    if (key_end == out.key) {
+        report_error(out.key, "Expected a key before ':'");
+        return false;
+    }
+    if (!last_non_space) {
+        report_error(out.value, "Expected a value after ':'");
+        return false;
+    }
+
+    *key_end = '\0';
+    last_non_space[1] = '\0';
+    return true;
+}
+
+static bool parse_int(const char* str, int& out) {
+    bool negative = *str == '-';
+    if (negative) str++;
+    if (*str == '\0') return false;
+
+    int value = 0;
+    for (; *str != '\0'; str++) {
+        if (*str < '0' || *str > '9') return false;
+        value = value * 10 + (*str - '0');
+    }
+    out = negative ? -value : value;
+    return true;
+}
+
+static void parse_stageid(const KeyValue& kv, u16* array) {
+    // Keys look like "STAGE 12"
+    int stage_id;
+    if (mkb::strncmp(kv.key, "STAGE ", 6) != 0 || !parse_int(kv.key + 6, stage_id)) {
+        report_error(kv.key, "Expected a key like 'STAGE 12'");
+        return;
+    }
+    if (stage_id < 0 || stage_id >= static_cast<int>(STAGE_ID_COUNT)) {
+        report_error(kv.key, "Stage ID out of range");
+        return;
+    }
+
+    int value;
+    if (!parse_int(kv.value, value)) {
+        report_error(kv.value, "Expected a decimal integer");
+        return;
+    }
+    array[stage_id] = static_cast<u16>(value);
+}
+
+static void parse_party_game_toggle(const KeyValue& kv) {
+    const KeyEntry<u16>* party_game = lookup(PARTY_GAMES, kv.key);
+    if (!party_game) {
+        report_error(kv.key, "Unknown party game");
+        return;
+    }
+
+    if (STREQ(kv.value, "enabled")) {
+        party_game_toggle::party_game_bitflag |= party_game->value;
+    }
+    else if (!STREQ(kv.value, "disabled")) {
+        report_error(kv.value, "Expected 'enabled' or 'disabled'");
+    }
+}
+
+// Set the value and initialize the patch if it differs from the default. Returns an error message on failure.
+static const char* set_patch_value(tickable::Tickable* tickable, int value) {
+    // Only set value on tickables that have a defined default active value
+    if (!tickable->active_value.has_value()) return "REL patch doesn't take a value";
+
+    // Check to see if the passed value is within the defined bounds
+    if (value < tickable->lower_bound) return "Passed value for patch smaller than minimum value";
+    if (value > tickable->upper_bound) return "Passed value for patch larger than maximum value";
+
+    // Set the enabled to the parsed value, if it differs from the default passed value.
+    // If the value is the default, do not enable the patch.
+    if (value != tickable->active_value) {
+        tickable->active_value = value;
+    }
+    return nullptr;
+}
+
+static void parse_function_toggle(const KeyValue& kv) {
+    // Set the state of a given tickable based on the found key
+    tickable::Tickable* tickable = tickable::get_tickable_manager().find(kv.key);
+    if (!tickable) {
+        report_error(kv.key, "Unknown REL patch");
+        return;
+    }
+
+    // 'value' is enabled, set the value to 1
+    if (STREQ(kv.value, "enabled")) {
+        tickable->enabled = true;
+        return;
+    }
+
+    // 'value' is disabled, set value to 0
+    if (STREQ(kv.value, "disabled")) {
+        return;
+    }
+
+    // 'value' is some integer
+    int parsed_value;
+    if (!parse_int(kv.value, parsed_value)) {
+        report_error(kv.value, "Expected 'enabled', 'disabled' or a decimal integer");
+        return;
+    }
+
+    const char* error = set_patch_value(tickable, parsed_value);
+    if (error) {
+        report_error(kv.value, error);
+    }
+}
+
+// Parse the start of a section of the config starting with # and ending with {
+// Example: # Section {
+static void begin_section(char* section_start, char* section_end) {
+    // Strip out the '# ' at the start of string, strip out the ' ' at the end
+    section_start++;
+    while (*section_start == ' ') section_start++;
+    while (section_end > section_start && section_end[-1] == ' ') section_end--;
+    *section_end = '\0';
+    char* section = section_start;
+
+    mkb::OSReport("[wsmod] Now parsing category %s...\n", section);
+
+    const KeyEntry<Section>* entry = lookup(SECTIONS, section);
+    if (!entry) {
+        s_section = Section::Unknown;
+        mkb::OSReport("[wsmod]  Unknown category %s found in config!\n", section);
+        return;
+    }
+
+    s_section = entry->value;
+    if (s_section == Section::DifficultyLayout) {
+        mkb::OSReport("%s\n", section);
+    }
+}
+
+static void end_section() {
+    if (s_section == Section::ThemeIds) {
+        mkb::OSReport("[wsmod]  Theme ID list loaded at: 0x%X\n", &main::theme_id_lookup);
+    }
+    else if (s_section == Section::MusicIds) {
+        mkb::OSReport("[wsmod]  Music ID list loaded at: 0x%X\n", &main::bgm_id_lookup);
+    }
+    s_section = Section::None;
+}
+
+static void parse_line(char* line) {
+    // Anything outside of a section is a comment
+    if (s_section == Section::None) {
+        char* section_end = mkb::strchr(line, '{');
+        if (line[0] == '#' && section_end != nullptr) {
+            begin_section(line, section_end);
+        }
+        return;
+    }
+
+    char* first_char = line;
+    while (*first_char == ' ' || *first_char == '\t') first_char++;
+
+    // Skip blank lines
+    if (*first_char == '\0') return;
+
+    if (*first_char == '}') {
+        end_section();
+        return;
+    }
+
+    if (s_section == Section::Unknown || s_section == Section::DifficultyLayout) return;
+
+    KeyValue kv;
+    if (!lex_key_value(line, kv)) return;
+
+    switch (s_section) {
+        case Section::RelPatches:
+            parse_function_toggle(kv);
+            break;
+        case Section::PartyGameToggles:
+            parse_party_game_toggle(kv);
+            break;
+        case Section::ThemeIds:
+            parse_stageid(kv, main::theme_id_lookup);
+            break;
+        case Section::MusicIds:
+            parse_stageid(kv, main::bgm_id_lookup);
+            break;
+        default:
+            break;
+    }
+}
+
+void begin_text() {
+    s_section = Section::None;
+    s_line_length = 0;
+    s_line_number = 0;
+}
+
+void parse_text(const char* chunk, u32 length) {
+    for (u32 i = 0; i < length; i++) {
+        char c = chunk[i];
+        if (c == '\n') {
+            s_line[s_line_length] = '\0';
+            s_line_number++;
+            parse_line(s_line);
+            s_line_length = 0;
+        }
+        else if (c != '\r' && s_line_length < LINE_SIZE - 1) {
+            s_line[s_line_length++] = c;
+        }
+    }
+}
+
+void end_text() {
+    // The last line may not end in a newline
+    if (s_line_length > 0) {
+        s_line[s_line_length] = '\0';
+        s_line_number++;
+        parse_line(s_line);
+        s_line_length = 0;
+    }
+}
+
+bool parse_compiled(const u8* blob, u32 blob_length, u32 text_length) {
+    const auto* header = reinterpret_cast<const CompiledHeader*>(blob);
+    if (blob_length < sizeof(CompiledHeader) || header->magic != COMPILED_MAGIC) return false;
+    if (header->version != COMPILED_VERSION) {
+        mkb::OSReport("[wsmod] config.bin has version %d, expected %d\n", header->version, COMPILED_VERSION);
+        return false;
+    }
+
+    u32 tables_offset = sizeof(CompiledHeader) + header->patch_count * sizeof(CompiledPatch);
+    u32 strings_offset = tables_offset + 2 * sizeof(main::theme_id_lookup);
+    if (header->size > blob_length || strings_offset > header->size ||
+        hashutil::fnv1a(blob + sizeof(CompiledHeader), header->size - sizeof(CompiledHeader)) != header->checksum) {
+        mkb::OSReport("[wsmod] config.bin is corrupt\n");
+        return false;
+    }
+
+    // Names must start inside the string table, which ends in a terminator
+    const auto* patches = reinterpret_cast<const CompiledPatch*>(blob + sizeof(CompiledHeader));
+    for (u32 i = 0; i < header->patch_count; i++) {
+        if (strings_offset + patches[i].name_offset >= header->size || blob[header->size - 1] != '\0') {
+            mkb::OSReport("[wsmod] config.bin is corrupt\n");
+            return false;
+        }
+    }
+    // Comparing lengths catches most edits without reading config.txt, which would cost as much as parsing it
+    if (text_length != NO_TEXT && header->text_length != text_length) {
+        mkb::OSReport("[wsmod] config.bin is out of date, recompile it from config.txt\n");
+        return false;
+    }
+
+    const char* strings = reinterpret_cast<const char*>(blob + strings_offset);
+    tickable::TickableManager& manager = tickable::get_tickable_manager();
+    for (u32 i = 0; i < header->patch_count; i++) {
+        const char* name = strings + patches[i].name_offset;
+        tickable::Tickable* tickable = manager.find(name);
+        if (!tickable) {
+            mkb::OSReport("[wsmod] config.bin: Unknown REL patch %s\n", name);
+            continue;
+        }
+
+        if (patches[i].state == CompiledPatch::ENABLED) {
+            tickable->enabled = true;
+        }
+        else if (patches[i].state == CompiledPatch::VALUE) {
+            const char* error = set_patch_value(tickable, patches[i].value);
+            if (error) {
+                mkb::OSReport("[wsmod] config.bin: %s: %s\n", name, error);
+            }
+        }
+    }
+
+    party_game_toggle::party_game_bitflag |= header->party_game_bitflag;
+    mkb::memcpy(main::theme_id_lookup, const_cast<u8*>(blob + tables_offset), sizeof(main::theme_id_lookup));
+    mkb::memcpy(main::bgm_id_lookup, const_cast<u8*>(blob + tables_offset + sizeof(main::theme_id_lookup)),
+                sizeof(main::bgm_id_lookup));
+    return true;
+}
+
+}// namespace config
@@ -0,0 +1,22 @@
+#pragma once
+#include "mkb/mkb.h"
+
+/*
+ * Parsing of config.txt and config.bin, independent of where their contents are read from. Depends on nothing but
+ * mkb's string functions, the tickable registry and the tables it fills in.
+ */
+namespace config {
+
+// Feed config.txt to the parser in chunks of any size, which may end partway through a line
+void begin_text();
+void parse_text(const char* chunk, u32 length);
+void end_text();
+
+// Passed as the config.txt length when there is no config.txt
+static constexpr u32 NO_TEXT = 0xFFFFFFFF;
+
+// Apply a config.bin, see script/compile-config.py for its format. `text_length` is the length of config.txt, to
+// detect a stale config.bin. Returns false if it isn't valid, in which case nothing was applied.
+bool parse_compiled(const u8* blob, u32 blob_length, u32 text_length);
+
+}// namespace config
@@ -2,6 +2,8 @@
 
 namespace main {
 
+mkb::GXColor debug_text_color = {};
+
 // TODO: make dyanmic
 u16 bgm_id_lookup[421] = {0};
 u16 theme_id_lookup[421] = {0};
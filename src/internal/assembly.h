@@ -29,9 +29,11 @@ void story_mode_music_hook();
 void reflection_draw_stage_hook();
 void reflection_view_stage_hook();
 
-// music_id_per_stage
+// custom_music_id
 extern u16 bgm_id_lookup[421];// TODO: make dynamic
-void get_bgm_id_hook();
+
+// patch::hook_instruction
+void instruction_hook_common();
 
 // theme_id_per_stage
 extern u16 theme_id_lookup[421];// TODO: make dynamic
@@ -1,25 +1,38 @@
 #include "heap.h"
+#include "pool.h"
+
+// Small objects come from fixed-size slabs, which don't pay for a 32-byte chunk header each
+static void* alloc_object(u32 size, void* callsite) {
+    void* ptr = heap::slab_alloc(size);
+    return ptr ? ptr : heap::alloc_from(size, callsite);
+}
+
+static void free_object(void* ptr) {
+    if (!heap::slab_free(ptr)) {
+        heap::free(ptr);
+    }
+}
 
 void* operator new(u32 size) {
-    return heap::alloc(size);
+    return alloc_object(size, __builtin_return_address(0));
 }
 
 void* operator new[](u32 size) {
-    return heap::alloc(size);
+    return alloc_object(size, __builtin_return_address(0));
 }
 
 void operator delete(void* ptr) {
-    heap::free(ptr);
+    free_object(ptr);
 }
 
 void operator delete[](void* ptr) {
-    heap::free(ptr);
+    free_object(ptr);
 }
 
 void operator delete(void* ptr, u32 size) {
-    heap::free(ptr);
+    free_object(ptr);
 }
 
 void operator delete[](void* ptr, u32 size) {
-    heap::free(ptr);
+    free_object(ptr);
 }
@@ -1,6 +1,7 @@
 #include "draw.h"
 
 #include "assembly.h"
+#include "heap.h"
 #include "mkb/mkb.h"
 #include "patch.h"
 #include <cstdarg>
@@ -9,6 +10,16 @@ using mkb::strlen;
 
 namespace draw {
 
+// Debug overlays stack downwards from here, in the order they're drawn each frame
+static constexpr s32 OVERLAY_TOP = 40;
+static constexpr s32 OVERLAY_GAP = 8;
+
+// Shouldn't be able to print a string to the screen longer than this
+static constexpr u32 DEBUG_TEXT_SIZE = 80;
+
+static bool s_initialized;
+static s32 s_overlay_y = OVERLAY_TOP;
+
 static char s_notify_msg_buf[80];
 static s32 s_notify_frame_counter;
 static mkb::GXColor s_notify_color;
@@ -22,10 +33,25 @@ const mkb::GXColor PURPLE = {0xb1, 0x5a, 0xff, 0xff};
 const mkb::GXColor GREEN = {0x00, 0xff, 0x00, 0xff};
 
 void init() {
+    if (s_initialized) return;
+    s_initialized = true;
+
     patch::write_branch(reinterpret_cast<void*>(0x802aeca4),
                         reinterpret_cast<void*>(main::full_debug_text_color));
 }
 
+void on_frame_start() {
+    s_overlay_y = OVERLAY_TOP;
+}
+
+s32 begin_overlay() {
+    return s_overlay_y;
+}
+
+void end_overlay(s32 next_y) {
+    s_overlay_y = next_y + OVERLAY_GAP;
+}
+
 void debug_text_palette() {
     for (char c = 0; c != 0x80; c++) {
         s32 x = c % 16 * DEBUG_CHAR_WIDTH;
@@ -35,6 +61,9 @@ void debug_text_palette() {
 }
 
 static void debug_text_buf(s32 x, s32 y, mkb::GXColor color, char* buf) {
+    // Only builds which draw debug text need the color hook
+    init();
+
     main::debug_text_color = color;
     for (s32 i = 0; buf[i] != '\0'; i++) {
         // Don't draw spaces, since they seem to draw a small line on the bottom of the cell
@@ -46,10 +75,12 @@ static void debug_text_buf(s32 x, s32 y, mkb::GXColor color, char* buf) {
 }
 
 static void debug_text_v(s32 x, s32 y, mkb::GXColor color, char* format, va_list args) {
-    // Shouldn't be able to print a string to the screen longer than this
+    // Formatted into the frame arena, then trimmed to what was printed
     // Be careful not to overflow! MKB2 doesn't have vsnprintf
-    static char buf[80];
+    char* buf = static_cast<char*>(heap::frame_alloc(DEBUG_TEXT_SIZE, 1));
+    if (!buf) return;
     mkb::vsprintf(buf, format, args);
+    heap::frame_shrink(buf, strlen(buf) + 1);
     debug_text_buf(x, y, color, buf);
 }
 
@@ -16,9 +16,13 @@ extern const mkb::GXColor GREEN;
 
 extern const mkb::GXColor color_map[];
 
-// Call once during mod initialization
+// Installs the hook which lets debug text be drawn in any color. Called the first time debug text is drawn, so the
+// game's code is left alone unless something draws debug text.
 void init();
 
+// Call once per frame, before anything is drawn
+void on_frame_start();
+
 // Call once per frame in the mkb 2d drawing hook
 void disp();
 
@@ -33,6 +37,11 @@ void rect(float x1, float y1, float x2, float y2, mkb::GXColor color);
 void debug_text_palette();
 void debug_text(s32 x, s32 y, mkb::GXColor color, char* format, ...);
 
+// Debug overlays are stacked on the left of the screen, so several can be shown at once. An overlay draws from the
+// y coordinate begin_overlay() returns, then passes the y coordinate below its last line to end_overlay().
+s32 begin_overlay();
+void end_overlay(s32 next_y);
+
 /*
  * Functions which cause drawing during disp() and don't necessarily need to be called each frame
  */
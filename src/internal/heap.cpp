@@ -1,12 +1,88 @@
 #include "heap.h"
 
+#include "log.h"
 #include "mkb/mkb.h"
 #include "relutil.h"
 #include <cinttypes>
 
 namespace heap {
 
+/*
+ * Other mods sharing our heap through modlink (like the Practice Mod) walk `first_free` and `first_used` with
+ * their own first-fit allocator, so those lists stay the authoritative record of the heap and chunk headers keep
+ * the layout of mkb::ChunkInfo.
+ *
+ * On top of that, free chunks are indexed in power-of-two size classes, so alloc() doesn't have to walk every
+ * free chunk. The index lives in the padding of each chunk header, along with a tag that lets free() validate a
+ * pointer without searching the used list.
+ *
+ * Indexed free chunks also end with a boundary tag pointing back at their header, so free() can merge a chunk
+ * with both of its physical neighbours in constant time. Freed chunks go to the front of `first_free` rather than
+ * being sorted in, which other allocators sharing the heap are fine with, since mkb::DLInsert only merges
+ * chunks that are actually adjacent. Whatever it fails to merge is merged when the index is rebuilt.
+ */
+struct ChunkMeta {
+    u32 tag;
+    mkb::ChunkInfo* class_prev;
+    mkb::ChunkInfo* class_next;
+    u32 size_class;
+#ifdef HEAP_INSTRUMENT
+    u32 callsite_idx;// Index into s_callsites of the allocating callsite, for used chunks
+#endif
+};
+static_assert(sizeof(ChunkMeta) <= sizeof(mkb::ChunkInfo::padding));
+
+static constexpr u32 HEADER_SIZE = sizeof(mkb::ChunkInfo);
+static_assert(HEADER_SIZE % 32 == 0);
+static constexpr u32 MIN_SPLIT_SIZE = HEADER_SIZE + 32;
+
+// Tags are mixed with the chunk's address, so stale data in a header is unlikely to pass for a valid tag
+static constexpr u32 USED_MAGIC = 0xC0DEA110;
+static constexpr u32 FREE_MAGIC = 0xF7EEC0DE;
+
+// Class n holds free chunks of size [32 << n, 32 << (n + 1))
+static constexpr u32 CLASS_COUNT = 27;
+
 static mkb::HeapInfo s_heap_info;
+static u32 s_heap_start;
+static u32 s_heap_end;
+
+static mkb::ChunkInfo* s_class_heads[CLASS_COUNT];
+static u32 s_class_bitmap;// Bit n is set if size class n is non-empty
+
+// Size of each of the two frame arena buffers
+static constexpr u32 FRAME_ARENA_SIZE = 0x1000;
+
+static u8* s_frame_arenas[2];
+static u32 s_frame_arena_idx;
+static u32 s_frame_arena_used;
+static u32 s_frame_last_offset;// Of the most recent allocation, which can still be shrunk
+static u32 s_frame_high_water;
+
+#ifdef HEAP_INSTRUMENT
+// Callsites which don't fit in the table anymore share its last entry
+static constexpr u32 CALLSITE_CAPACITY = 32;
+// Marks used chunks which other mods allocated through their own allocator
+static constexpr u32 NO_CALLSITE = 0xFFFFFFFF;
+
+static CallsiteStats s_callsites[CALLSITE_CAPACITY];
+static u32 s_callsite_count;
+static u32 s_used_space;
+static u32 s_peak_used_space;
+
+static TraceEvent s_trace[TRACE_CAPACITY];
+static u32 s_trace_count;
+static bool s_trace_frozen;
+
+static CallsiteStats s_saved_callsites[CALLSITE_CAPACITY];
+static u32 s_saved_callsite_count;
+static u32 s_saved_used_space;
+static u32 s_saved_peak_used_space;
+#endif
+
+// Head of `first_used` after our last operation. Foreign allocators always push new chunks to the front of
+// `first_used`, so if this no longer matches, the index may be stale.
+static mkb::ChunkInfo* s_synced_first_used;
 
 mkb::ChunkInfo* extract_chunk(mkb::ChunkInfo* list, mkb::ChunkInfo* chunk) {
     if (chunk->next) {
@@ -33,64 +109,282 @@ mkb::ChunkInfo* add_chunk_to_front(mkb::ChunkInfo* list, mkb::ChunkInfo* chunk)
     return chunk;
 }
 
-mkb::ChunkInfo* find_chunk_in_list(mkb::ChunkInfo* list, mkb::ChunkInfo* chunk) {
-    for (; list; list = list->next) {
-        if (list == chunk) {
-            return list;
+static ChunkMeta& meta(mkb::ChunkInfo* chunk) {
+    return *reinterpret_cast<ChunkMeta*>(chunk->padding);
+}
+
+static u32 used_tag(mkb::ChunkInfo* chunk) { return USED_MAGIC ^ reinterpret_cast<u32>(chunk); }
+static u32 free_tag(mkb::ChunkInfo* chunk) { return FREE_MAGIC ^ reinterpret_cast<u32>(chunk); }
+
+static bool in_heap(mkb::ChunkInfo* chunk) {
+    u32 chunk_raw = reinterpret_cast<u32>(chunk);
+    return chunk_raw >= s_heap_start && chunk_raw + HEADER_SIZE <= s_heap_end && (chunk_raw & 31) == 0;
+}
+
+static mkb::ChunkInfo** footer(mkb::ChunkInfo* chunk) {
+    return reinterpret_cast<mkb::ChunkInfo**>(reinterpret_cast<u32>(chunk) + chunk->size - sizeof(mkb::ChunkInfo*));
+}
+
+static u32 size_class(u32 size) {
+    u32 cls = 31 - __builtin_clz(size) - 5;
+    return cls < CLASS_COUNT ? cls : CLASS_COUNT - 1;
+}
+
+static void index_insert(mkb::ChunkInfo* chunk) {
+    u32 cls = size_class(chunk->size);
+    ChunkMeta& m = meta(chunk);
+    m.tag = free_tag(chunk);
+    m.size_class = cls;
+    m.class_prev = nullptr;
+    m.class_next = s_class_heads[cls];
+    if (m.class_next) {
+        meta(m.class_next).class_prev = chunk;
+    }
+    s_class_heads[cls] = chunk;
+    s_class_bitmap |= 1 << cls;
+
+    // Boundary tag, so the chunk after this one can find it when it's freed
+    *footer(chunk) = chunk;
+}
+
+static void index_remove(mkb::ChunkInfo* chunk) {
+    ChunkMeta& m = meta(chunk);
+    if (m.class_next) {
+        meta(m.class_next).class_prev = m.class_prev;
+    }
+    if (m.class_prev) {
+        meta(m.class_prev).class_next = m.class_next;
+    }
+    else {
+        s_class_heads[m.size_class] = m.class_next;
+        if (!m.class_next) {
+            s_class_bitmap &= ~(1 << m.size_class);
         }
     }
-    return nullptr;
+    m.tag = 0;
 }
 
-static void make_heap() {
-    u32 start = mkb::OSRoundUp32B(*reinterpret_cast<u32*>(0x8000452C));
-    void* end_ptr = relutil::compute_mainloop_reldata_boundary();// TODO precompute?
-    u32 end = mkb::OSRoundDown32B(reinterpret_cast<u32>(end_ptr));
+// Whether an indexed chunk is still a free chunk linked into `first_free`, in constant time
+static bool is_linked_free(mkb::ChunkInfo* chunk) {
+    if (!in_heap(chunk) || meta(chunk).tag != free_tag(chunk)) return false;
+    if (chunk->prev ? chunk->prev->next != chunk : s_heap_info.first_free != chunk) return false;
+    if (chunk->next && chunk->next->prev != chunk) return false;
+    return true;
+}
+
+static mkb::ChunkInfo* next_in_memory(mkb::ChunkInfo* chunk) {
+    return reinterpret_cast<mkb::ChunkInfo*>(reinterpret_cast<u32>(chunk) + chunk->size);
+}
+
+// Merge physically adjacent free chunks which other mods freed without merging them, as mkb::DLInsert can
+// only merge with its neighbours in the free list, which isn't sorted by address anymore
+static void merge_adjacent_free_chunks() {
+    mkb::ChunkInfo* chunk = reinterpret_cast<mkb::ChunkInfo*>(s_heap_start);
+    while (in_heap(chunk) && chunk->size >= HEADER_SIZE) {
+        mkb::ChunkInfo* following = next_in_memory(chunk);
+        if (meta(chunk).tag == free_tag(chunk) && in_heap(following) && meta(following).tag == free_tag(following)) {
+            s_heap_info.first_free = extract_chunk(s_heap_info.first_free, following);
+            meta(following).tag = 0;
+            chunk->size += following->size;
+        }
+        else {
+            chunk = following;
+        }
+    }
+}
+
+// Rebuild the size class index and chunk tags from the authoritative heap lists
+static void rebuild_index() {
+    for (u32 i = 0; i < CLASS_COUNT; i++) {
+        s_class_heads[i] = nullptr;
+    }
+    s_class_bitmap = 0;
+
+    for (mkb::ChunkInfo* chunk = s_heap_info.first_used; chunk; chunk = chunk->next) {
+#ifdef HEAP_INSTRUMENT
+        if (meta(chunk).tag != used_tag(chunk)) {
+            meta(chunk).callsite_idx = NO_CALLSITE;
+        }
+#endif
+        meta(chunk).tag = used_tag(chunk);
+    }
+    for (mkb::ChunkInfo* chunk = s_heap_info.first_free; chunk; chunk = chunk->next) {
+        meta(chunk).tag = free_tag(chunk);
+    }
+    merge_adjacent_free_chunks();
+    for (mkb::ChunkInfo* chunk = s_heap_info.first_free; chunk; chunk = chunk->next) {
+        index_insert(chunk);
+    }
+    s_synced_first_used = s_heap_info.first_used;
+}
+
+static void sync_index() {
+    if (s_heap_info.first_used != s_synced_first_used) {
+        rebuild_index();
+    }
+}
+
+// Find the free chunk physically preceding this one through its boundary tag, or nullptr if there isn't one.
+// Free chunks we haven't indexed (like ones other mods freed) don't have a valid boundary tag, which is fine,
+// they just don't get merged until they're indexed.
+static mkb::ChunkInfo* prev_in_memory(mkb::ChunkInfo* chunk) {
+    u32 chunk_raw = reinterpret_cast<u32>(chunk);
+    if (chunk_raw <= s_heap_start) return nullptr;
+
+    mkb::ChunkInfo* preceding = *reinterpret_cast<mkb::ChunkInfo**>(chunk_raw - sizeof(mkb::ChunkInfo*));
+    if (!in_heap(preceding) || reinterpret_cast<u32>(preceding) >= chunk_raw) return nullptr;
+    if (next_in_memory(preceding) != chunk || !is_linked_free(preceding)) return nullptr;
+    return preceding;
+}
+
+enum class FindResult {
+    Found,
+    NotFound,
+    StaleIndex,
+};
+
+static FindResult find_free_chunk(u32 size, mkb::ChunkInfo*& found) {
+    u32 cls = size_class(size);
+
+    // Chunks in the request's own class may still be too small, so search it first-fit
+    for (mkb::ChunkInfo* chunk = s_class_heads[cls]; chunk; chunk = meta(chunk).class_next) {
+        if (!is_linked_free(chunk)) return FindResult::StaleIndex;
+        if (chunk->size >= size) {
+            found = chunk;
+            return FindResult::Found;
+        }
+    }
+
+    // Any chunk in a larger class fits, so take from the smallest non-empty one
+    u32 larger_classes = s_class_bitmap & ~((2 << cls) - 1);
+    if (!larger_classes) return FindResult::NotFound;
+
+    mkb::ChunkInfo* chunk = s_class_heads[__builtin_ctz(larger_classes)];
+    if (!is_linked_free(chunk)) return FindResult::StaleIndex;
+    found = chunk;
+    return FindResult::Found;
+}
+
+#ifdef HEAP_INSTRUMENT
+static u32 find_callsite(void* callsite) {
+    u32 callsite_raw = reinterpret_cast<u32>(callsite);
+    for (u32 i = 0; i < s_callsite_count; i++) {
+        if (s_callsites[i].callsite == callsite_raw) return i;
+    }
+
+    if (s_callsite_count < CALLSITE_CAPACITY) {
+        s_callsites[s_callsite_count].callsite = callsite_raw;
+        return s_callsite_count++;
+    }
+
+    // Table is full, so lump it in with the other overflowing callsites
+    s_callsites[CALLSITE_CAPACITY - 1].callsite = 0;
+    return CALLSITE_CAPACITY - 1;
+}
+
+static void track_alloc(mkb::ChunkInfo* chunk, void* callsite) {
+    u32 idx = find_callsite(callsite);
+    CallsiteStats& stats = s_callsites[idx];
+    stats.live_bytes += chunk->size;
+    stats.live_count++;
+    if (stats.live_bytes > stats.peak_bytes) {
+        stats.peak_bytes = stats.live_bytes;
+    }
+    meta(chunk).callsite_idx = idx;
+
+    s_used_space += chunk->size;
+    if (s_used_space > s_peak_used_space) {
+        s_peak_used_space = s_used_space;
+    }
+}
+
+static void record_event(u32 size, void* ptr) {
+    if (s_trace_frozen || s_trace_count == TRACE_CAPACITY) return;
+    s_trace[s_trace_count++] = {size, ptr};
+}
+
+static void track_free(mkb::ChunkInfo* chunk) {
+    u32 idx = meta(chunk).callsite_idx;
+    if (idx >= s_callsite_count) return;
+
+    CallsiteStats& stats = s_callsites[idx];
+    stats.live_bytes -= chunk->size;
+    stats.live_count--;
+    s_used_space -= chunk->size;
+}
+
+void save_stats() {
+    mkb::memcpy(s_saved_callsites, s_callsites, sizeof(s_callsites));
+    s_saved_callsite_count = s_callsite_count;
+    s_saved_used_space = s_used_space;
+    s_saved_peak_used_space = s_peak_used_space;
+}
+
+void restore_stats() {
+    mkb::memcpy(s_callsites, s_saved_callsites, sizeof(s_callsites));
+    s_callsite_count = s_saved_callsite_count;
+    s_used_space = s_saved_used_space;
+    s_peak_used_space = s_saved_peak_used_space;
+}
+#endif
+
+// The allocator itself doesn't depend on where the heap lives, only init() does
+static void make_heap(u32 start, u32 end) {
     u32 size = end - start;
 
     mkb::memset(reinterpret_cast<void*>(start), 0, size);
 
+    s_heap_start = start;
+    s_heap_end = end;
+
     s_heap_info.capacity = size;
     s_heap_info.first_free = reinterpret_cast<mkb::ChunkInfo*>(start);
     s_heap_info.first_free->next = nullptr;
     s_heap_info.first_free->prev = nullptr;
     s_heap_info.first_free->size = size;
     s_heap_info.first_used = nullptr;
+
+    rebuild_index();
 }
 
 void* alloc(u32 size) {
+    return alloc_from(size, __builtin_return_address(0));
+}
+
+void* alloc_from(u32 size, void* callsite) {
     // Enlarge size to the smallest possible chunk size
-    u32 new_size = size + mkb::OSRoundUp32B(sizeof(mkb::ChunkInfo));
-    new_size = mkb::OSRoundUp32B(new_size);
+    u32 new_size = mkb::OSRoundUp32B(size + HEADER_SIZE);
 
-    mkb::ChunkInfo* temp_chunk = nullptr;
+    sync_index();
 
-    // Find a memory area large enough
-    for (temp_chunk = s_heap_info.first_free; temp_chunk; temp_chunk = temp_chunk->next) {
-        if (new_size <= temp_chunk->size) {
-            break;
-        }
+    // Find a memory area large enough. If the index doesn't agree with the heap lists (or has no fit, in case
+    // another mod freed memory behind our back), rebuild it and try once more.
+    mkb::ChunkInfo* temp_chunk = nullptr;
+    FindResult result = find_free_chunk(new_size, temp_chunk);
+    if (result != FindResult::Found) {
+        rebuild_index();
+        result = find_free_chunk(new_size, temp_chunk);
     }
 
     // Make sure the found region is valid
-    if (!temp_chunk) {
+    if (result != FindResult::Found) {
         return nullptr;
     }
 
-    s32 leftover_size = temp_chunk->size - new_size;
+    index_remove(temp_chunk);
 
-    s32 min_size = mkb::OSRoundUp32B(sizeof(mkb::ChunkInfo)) + 32;
+    u32 leftover_size = temp_chunk->size - new_size;
 
     // Check if the current chunk can be split into two pieces
-    if (leftover_size < min_size) {
+    if (leftover_size < MIN_SPLIT_SIZE) {
         // Too small to split, so just extract it
         s_heap_info.first_free = extract_chunk(s_heap_info.first_free, temp_chunk);
     }
     else {
         // Large enough to split
-        temp_chunk->size = static_cast<s32>(new_size);
+        temp_chunk->size = new_size;
 
-        // Create a new chunk
+        // Create a new chunk, taking the place of the old one in the free list
         mkb::ChunkInfo* new_chunk =
             reinterpret_cast<mkb::ChunkInfo*>(reinterpret_cast<u32>(temp_chunk) + new_size);
 
@@ -109,40 +403,95 @@ void* alloc(u32 size) {
         else {
             s_heap_info.first_free = new_chunk;
         }
+
+        index_insert(new_chunk);
     }
 
     // Add the chunk to the allocated list
+    meta(temp_chunk).tag = used_tag(temp_chunk);
+#ifdef HEAP_INSTRUMENT
+    track_alloc(temp_chunk, callsite);
+#endif
     s_heap_info.first_used = add_chunk_to_front(s_heap_info.first_used, temp_chunk);
+    s_synced_first_used = s_heap_info.first_used;
 
     // Add the header size to the chunk
-    void* allocated_memory = reinterpret_cast<void*>(reinterpret_cast<u32>(temp_chunk) +
-                                                     mkb::OSRoundUp32B(sizeof(mkb::ChunkInfo)));
+    void* allocated_memory = reinterpret_cast<void*>(reinterpret_cast<u32>(temp_chunk) + HEADER_SIZE);
 
     mkb::memset(allocated_memory, 0, size);
+#ifdef HEAP_INSTRUMENT
+    record_event(size, allocated_memory);
+#endif
     return allocated_memory;
 }
 
 bool free(void* ptr) {
     u32 ptr_raw = reinterpret_cast<u32>(ptr);
 
-    u32 header_size = mkb::OSRoundUp32B(sizeof(mkb::ChunkInfo));
-
     // Remove the header size from ptr, as the value stored in the list does not include it
-    mkb::ChunkInfo* temp_chunk = reinterpret_cast<mkb::ChunkInfo*>(ptr_raw - header_size);
+    mkb::ChunkInfo* temp_chunk = reinterpret_cast<mkb::ChunkInfo*>(ptr_raw - HEADER_SIZE);
+
+    sync_index();
 
     // Make sure ptr is actually allocated
-    if (!find_chunk_in_list(s_heap_info.first_used, temp_chunk)) {
+    if (!in_heap(temp_chunk) || meta(temp_chunk).tag != used_tag(temp_chunk)) {
         return false;
     }
 
+#ifdef HEAP_INSTRUMENT
+    track_free(temp_chunk);
+    record_event(0, ptr);
+#endif
+
     // Extract the chunk from the allocated list
     s_heap_info.first_used = extract_chunk(s_heap_info.first_used, temp_chunk);
+    s_synced_first_used = s_heap_info.first_used;
+
+    // Merge with the physically following chunk, if it's free
+    mkb::ChunkInfo* following = next_in_memory(temp_chunk);
+    if (in_heap(following) && is_linked_free(following)) {
+        index_remove(following);
+        s_heap_info.first_free = extract_chunk(s_heap_info.first_free, following);
+        temp_chunk->size += following->size;
+    }
+
+    // Merge into the physically preceding chunk, if it's free, which keeps its place in the free list.
+    // Otherwise, the chunk goes to the front of the free list.
+    mkb::ChunkInfo* preceding = prev_in_memory(temp_chunk);
+    if (preceding) {
+        index_remove(preceding);
+        preceding->size += temp_chunk->size;
+        meta(temp_chunk).tag = 0;
+        index_insert(preceding);
+    }
+    else {
+        s_heap_info.first_free = add_chunk_to_front(s_heap_info.first_free, temp_chunk);
+        index_insert(temp_chunk);
+    }
 
-    // Add in sorted order to the free list
-    s_heap_info.first_free = mkb::DLInsert(s_heap_info.first_free, temp_chunk);
     return true;
 }
 
+FragmentationReport defragment_report() {
+    FragmentationReport report = {};
+    u32 largest_chunk = 0;
+    for (mkb::ChunkInfo* chunk = s_heap_info.first_free; chunk; chunk = chunk->next) {
+        report.free_space += chunk->size - HEADER_SIZE;
+        report.free_chunk_count++;
+        if (chunk->size > largest_chunk) {
+            largest_chunk = chunk->size;
+        }
+    }
+
+    if (largest_chunk > 0) {
+        report.largest_free = largest_chunk - HEADER_SIZE;
+    }
+    if (report.free_space > 0) {
+        report.fragmentation = 1.0f - static_cast<f32>(report.largest_free) / report.free_space;
+    }
+    return report;
+}
+
 u32 get_free_space() {
     u32 space = 0;
     for (mkb::ChunkInfo* chunk = s_heap_info.first_free; chunk; chunk = chunk->next) {
@@ -153,9 +502,12 @@ u32 get_free_space() {
 
 u32 get_total_space() { return s_heap_info.capacity; }
 
-void check_integrity() {
+bool check_integrity() {
     bool valid = true;
 
+    // Tag any chunks other mods allocated since our last operation
+    sync_index();
+
     mkb::ChunkInfo* current_chunk = nullptr;
     mkb::ChunkInfo* prev_chunk = nullptr;
     for (current_chunk = s_heap_info.first_used; current_chunk;
@@ -183,21 +535,121 @@ void check_integrity() {
             break;
         }
 
+        // Check the chunk header hasn't been overwritten
+        if (meta(current_chunk).tag != used_tag(current_chunk)) {
+            valid = false;
+            break;
+        }
+
         prev_chunk = current_chunk;
     }
 
     if (!valid) {
         // Print the error message to the console
         mkb::OSReport("Heap corrupt at 0x%08" PRIx32 "\n", reinterpret_cast<u32>(current_chunk));
+#ifdef HEAP_INSTRUMENT
+        // The chunk which was allocated right before the corrupt one is the most likely culprit
+        if (prev_chunk && meta(prev_chunk).callsite_idx < s_callsite_count) {
+            mkb::OSReport("Last valid chunk 0x%08" PRIx32 " allocated from 0x%08" PRIx32 "\n",
+                          reinterpret_cast<u32>(prev_chunk),
+                          s_callsites[meta(prev_chunk).callsite_idx].callsite);
+        }
+        report_callsites();
+#endif
+    }
+    return valid;
+}
+
+#ifdef HEAP_INSTRUMENT
+u32 get_top_callsites(CallsiteStats* out, u32 max) {
+    u32 count = 0;
+    for (u32 i = 0; i < s_callsite_count; i++) {
+        if (s_callsites[i].live_count == 0) continue;
+
+        // Insertion sort by live bytes, dropping whatever falls off the end
+        u32 pos = count < max ? count++ : max;
+        while (pos > 0 && out[pos - 1].live_bytes < s_callsites[i].live_bytes) {
+            if (pos < max) {
+                out[pos] = out[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < max) {
+            out[pos] = s_callsites[i];
+        }
+    }
+    return count;
+}
+
+const TraceEvent* get_trace(u32& count) {
+    s_trace_frozen = true;
+    count = s_trace_count;
+    return s_trace;
+}
+
+u32 get_used_space() { return s_used_space; }
+u32 get_peak_used_space() { return s_peak_used_space; }
+
+void report_callsites() {
+    mkb::OSReport("[wsmod] Heap: %d bytes used by us (peak %d)\n", s_used_space, s_peak_used_space);
+    for (u32 i = 0; i < s_callsite_count; i++) {
+        const CallsiteStats& stats = s_callsites[i];
+        mkb::OSReport("[wsmod]   0x%08" PRIx32 ": %d bytes in %d chunks (peak %d)\n",
+                      stats.callsite, stats.live_bytes, stats.live_count, stats.peak_bytes);
     }
 }
+#endif
 
 void init() {
-    make_heap();
+    u32 start = mkb::OSRoundUp32B(*reinterpret_cast<u32*>(0x8000452C));
+    void* end_ptr = relutil::compute_mainloop_reldata_boundary();// TODO precompute?
+    u32 end = mkb::OSRoundDown32B(reinterpret_cast<u32>(end_ptr));
+    make_heap(start, end);
 }
 
 mkb::HeapInfo& get_heap_info() {
     return s_heap_info;
 }
 
+void* frame_alloc(u32 size, u32 align) {
+    MOD_ASSERT_MSG(align != 0 && (align & (align - 1)) == 0 && align <= 32,
+                   "Frame arena alignment must be a power of two, up to 32");
+
+    // Only take the arenas from the heap once someone actually needs them
+    if (!s_frame_arenas[0]) {
+        u8* arenas = static_cast<u8*>(alloc(FRAME_ARENA_SIZE * 2));
+        if (!arenas) return nullptr;
+        s_frame_arenas[0] = arenas;
+        s_frame_arenas[1] = arenas + FRAME_ARENA_SIZE;
+    }
+
+    // Arenas are 32-byte aligned, so aligning the offset aligns the pointer
+    u32 offset = (s_frame_arena_used + align - 1) & ~(align - 1);
+    if (offset + size > FRAME_ARENA_SIZE) return nullptr;
+
+    s_frame_last_offset = offset;
+    s_frame_arena_used = offset + size;
+    if (s_frame_arena_used > s_frame_high_water) {
+        s_frame_high_water = s_frame_arena_used;
+    }
+    return s_frame_arenas[s_frame_arena_idx] + offset;
+}
+
+void frame_shrink(void* ptr, u32 size) {
+    if (ptr != s_frame_arenas[s_frame_arena_idx] + s_frame_last_offset) return;
+    if (s_frame_last_offset + size < s_frame_arena_used) {
+        s_frame_arena_used = s_frame_last_offset + size;
+    }
+}
+
+void frame_reset() {
+    // Swap buffers, so last frame's allocations survive through this one
+    s_frame_arena_idx ^= 1;
+    s_frame_arena_used = 0;
+}
+
+u32 get_frame_high_water() {
+    return s_frame_high_water;
+}
+
 }// namespace heap
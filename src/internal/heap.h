@@ -4,12 +4,83 @@
 
 namespace heap {
 
+struct FragmentationReport {
+    u32 free_space;      // Total free bytes, not counting chunk headers
+    u32 largest_free;    // Largest allocation that can currently succeed
+    u32 free_chunk_count;
+    f32 fragmentation;   // 0 when all free memory is in one chunk, approaching 1 as it splinters
+};
+
 void init();
 void* alloc(u32 size);
+// Like alloc(), but attributes the allocation to `callsite` rather than to the caller in instrumented builds
+void* alloc_from(u32 size, void* callsite);
 bool free(void* ptr);
-void check_integrity();
+// Prints where the heap is corrupt to the console if it is
+bool check_integrity();
 u32 get_free_space();
 u32 get_total_space();
 mkb::HeapInfo& get_heap_info();
+FragmentationReport defragment_report();
+
+#ifdef HEAP_INSTRUMENT
+/*
+ * Instrumented builds (`make HEAP_INSTRUMENT=1`) track how much of the heap each allocating callsite holds.
+ * Byte counts include chunk headers. Memory other mods allocate from the shared heap isn't attributed.
+ */
+
+struct CallsiteStats {
+    u32 callsite;// Return address of the allocating call, or 0 for callsites which didn't fit in the table
+    u32 live_bytes;
+    u32 live_count;
+    u32 peak_bytes;
+};
+
+// Fills `out` with up to `max` callsites holding the most memory, largest first. Returns how many were written.
+u32 get_top_callsites(CallsiteStats* out, u32 max);
+u32 get_used_space();
+u32 get_peak_used_space();
+
+// Print every callsite's stats to the console
+void report_callsites();
+
+// Set the stats aside and bring them back, so a burst of allocations which are all freed again by the time of the
+// restore (like a benchmark's) doesn't count towards the peaks or take up callsite table entries
+void save_stats();
+void restore_stats();
+
+// The first TRACE_CAPACITY allocations and frees we served, so real allocation patterns can be replayed
+static constexpr u32 TRACE_CAPACITY = 256;
+
+struct TraceEvent {
+    u32 size;// Requested size of an allocation, or 0 for a free
+    void* ptr;
+};
+
+// Stops recording, so reading the trace and replaying it doesn't change it
+const TraceEvent* get_trace(u32& count);
+
+// Benchmark and stress the allocator with random and recorded traces, and print the results to the console.
+// Leaves the heap and its stats as it found them.
+void run_benchmark();
+#endif
+
+/*
+ * Per-frame scratch memory. Allocation is a pointer bump, and memory never needs to be freed: it stays valid
+ * until the end of the frame after the one it was allocated in, then gets reused.
+ *
+ * `align` must be a power of two, up to 32. Returns nullptr if this frame's arena is exhausted.
+ */
+void* frame_alloc(u32 size, u32 align = 4);
+
+// Give back the end of the most recent frame allocation, keeping its first `size` bytes. Does nothing for older
+// allocations, so a buffer can be allocated at its largest possible size and trimmed once it's filled in.
+void frame_shrink(void* ptr, u32 size);
+
+// Call once at the start of each frame
+void frame_reset();
+
+// Most bytes allocated from the frame arena in a single frame so far
+u32 get_frame_high_water();
 
 }// namespace heap
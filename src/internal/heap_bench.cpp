@@ -0,0 +1,166 @@
+#include "heap.h"
+
+#ifdef HEAP_INSTRUMENT
+
+#include "mkb/mkb.h"
+
+namespace heap {
+
+static constexpr u32 MAX_LIVE = 128;
+static constexpr u32 RANDOM_OP_COUNT = 4096;
+static constexpr u32 REPLAY_COUNT = 16;
+
+// How often fragmentation is sampled and the heap is checked, in operations
+static constexpr u32 SAMPLE_INTERVAL = 16;
+
+struct BenchResult {
+    u32 op_count;
+    u32 failed_count;// Allocations which returned nullptr
+    u32 ticks;       // Spent in alloc() and free() only
+    f32 peak_fragmentation;
+    u32 integrity_failures;
+};
+
+class Bench {
+public:
+    void* alloc(u32 size) {
+        mkb::OSTick start = mkb::OSGetTick();
+        void* ptr = heap::alloc(size);
+        m_result.ticks += mkb::OSGetTick() - start;
+        m_result.op_count++;
+        if (!ptr) m_result.failed_count++;
+        sample();
+        return ptr;
+    }
+
+    void free(void* ptr) {
+        mkb::OSTick start = mkb::OSGetTick();
+        heap::free(ptr);
+        m_result.ticks += mkb::OSGetTick() - start;
+        m_result.op_count++;
+        sample();
+    }
+
+    void report(const char* name) const {
+        // The timebase runs at a quarter of the bus clock
+        u32 ticks_per_us = mkb::BUS_CLOCK_SPEED / 4 / 1000000;
+        f32 ns = static_cast<f32>(m_result.ticks) * 1000 / ticks_per_us;
+        u32 ns_per_op = m_result.op_count ? static_cast<u32>(ns / m_result.op_count) : 0;
+        mkb::OSReport("[wsmod] Heap bench %s: %d ops, %d ns/op, %d failed allocs, %d%% peak frag, %d integrity failures\n",
+                      name, m_result.op_count, ns_per_op, m_result.failed_count,
+                      static_cast<s32>(m_result.peak_fragmentation * 100), m_result.integrity_failures);
+    }
+
+private:
+    void sample() {
+        if (m_result.op_count % SAMPLE_INTERVAL != 0) return;
+
+        FragmentationReport frag = defragment_report();
+        if (frag.fragmentation > m_result.peak_fragmentation) {
+            m_result.peak_fragmentation = frag.fragmentation;
+        }
+        if (!check_integrity()) {
+            m_result.integrity_failures++;
+        }
+    }
+
+    BenchResult m_result = {};
+};
+
+static u32 s_rng_state = 0x2545F491;
+
+static u32 rand() {
+    // xorshift32
+    s_rng_state ^= s_rng_state << 13;
+    s_rng_state ^= s_rng_state >> 17;
+    s_rng_state ^= s_rng_state << 5;
+    return s_rng_state;
+}
+
+// Mostly small allocations with the occasional large one, like the mod's own
+static u32 rand_size() {
+    u32 r = rand();
+    if (r % 8 == 0) return 1024 + r % 4096;
+    return 8 + r % 256;
+}
+
+static void bench_random() {
+    static void* s_live[MAX_LIVE];
+    u32 live_count = 0;
+    Bench bench;
+
+    for (u32 i = 0; i < RANDOM_OP_COUNT; i++) {
+        // Allocate more often than free while there's room, so the heap fills up and churns
+        bool do_alloc = live_count == 0 || (live_count < MAX_LIVE && rand() % 8 < 5);
+        if (do_alloc) {
+            void* ptr = bench.alloc(rand_size());
+            if (ptr) s_live[live_count++] = ptr;
+        }
+        else {
+            u32 idx = rand() % live_count;
+            bench.free(s_live[idx]);
+            s_live[idx] = s_live[--live_count];
+        }
+    }
+    while (live_count > 0) {
+        bench.free(s_live[--live_count]);
+    }
+
+    bench.report("random");
+}
+
+static void bench_replay(const TraceEvent* trace, u32 trace_count) {
+    // Maps pointers in the trace to the pointers we got while replaying it
+    static void* s_recorded[MAX_LIVE];
+    static void* s_replayed[MAX_LIVE];
+    Bench bench;
+
+    for (u32 replay = 0; replay < REPLAY_COUNT; replay++) {
+        u32 live_count = 0;
+        for (u32 i = 0; i < trace_count; i++) {
+            const TraceEvent& event = trace[i];
+            if (event.size > 0) {
+                if (live_count == MAX_LIVE) continue;
+                void* ptr = bench.alloc(event.size);
+                if (!ptr) continue;
+                s_recorded[live_count] = event.ptr;
+                s_replayed[live_count] = ptr;
+                live_count++;
+            }
+            else {
+                // Frees of memory allocated before recording started, or that didn't fit, are skipped
+                for (u32 j = 0; j < live_count; j++) {
+                    if (s_recorded[j] == event.ptr) {
+                        bench.free(s_replayed[j]);
+                        live_count--;
+                        s_recorded[j] = s_recorded[live_count];
+                        s_replayed[j] = s_replayed[live_count];
+                        break;
+                    }
+                }
+            }
+        }
+
+        // Whatever the mod still holds onto at the end of the trace
+        while (live_count > 0) {
+            bench.free(s_replayed[--live_count]);
+        }
+    }
+
+    bench.report("replay");
+}
+
+void run_benchmark() {
+    // Freeze the trace first, so it holds the mod's own allocations rather than the random benchmark's
+    u32 trace_count;
+    const TraceEvent* trace = get_trace(trace_count);
+
+    save_stats();
+    bench_random();
+    bench_replay(trace, trace_count);
+    restore_stats();
+}
+
+}// namespace heap
+
+#endif
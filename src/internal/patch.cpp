@@ -1,11 +1,138 @@
 #include "patch.h"
 
+#include "assembly.h"
+#include "heap.h"
+#include "log.h"
+#include "tickable.h"
+#include "utils/ppcutil.h"
+
+#include <cstddef>
+
 namespace patch {
-void clear_dc_ic_cache(void* ptr, u32 size) {
+
+static constexpr u32 CACHE_LINE_SIZE = 32;
+// Cache lines written to while flushes are deferred. Further lines are flushed right away when this fills up
+static constexpr u32 MAX_DIRTY_LINES = 64;
+
+static u32 s_dirty_lines[MAX_DIRTY_LINES];
+static u32 s_dirty_line_count = 0;
+static u32 s_defer_depth = 0;
+
+static UndoLog* s_undo_log = nullptr;
+
+static void flush_range(void* ptr, u32 size) {
     mkb::DCFlushRange(ptr, size);
     mkb::ICInvalidateRange(ptr, size);
 }
 
+static void defer_line(u32 line) {
+    for (u32 i = 0; i < s_dirty_line_count; i++) {
+        if (s_dirty_lines[i] == line) return;
+    }
+    if (s_dirty_line_count == MAX_DIRTY_LINES) {
+        flush_range(reinterpret_cast<void*>(line), CACHE_LINE_SIZE);
+        return;
+    }
+    s_dirty_lines[s_dirty_line_count++] = line;
+}
+
+void clear_dc_ic_cache(void* ptr, u32 size) {
+    if (s_defer_depth == 0) {
+        flush_range(ptr, size);
+        return;
+    }
+
+    u32 start = reinterpret_cast<u32>(ptr) & ~(CACHE_LINE_SIZE - 1);
+    u32 end = reinterpret_cast<u32>(ptr) + size;
+    for (u32 line = start; line < end; line += CACHE_LINE_SIZE) {
+        defer_line(line);
+    }
+}
+
+void UndoLog::record(u32* ptr, u32 old_word) {
+    if (m_count == m_capacity) {
+        u16 new_capacity = m_capacity ? m_capacity * 2 : 8;
+        UndoEntry* new_entries = static_cast<UndoEntry*>(heap::alloc(new_capacity * sizeof(UndoEntry)));
+        if (!new_entries) {
+            m_complete = false;
+            return;
+        }
+        if (m_entries) {
+            mkb::memcpy(new_entries, m_entries, m_count * sizeof(UndoEntry));
+            heap::free(m_entries);
+        }
+        m_entries = new_entries;
+        m_capacity = new_capacity;
+    }
+    m_entries[m_count++] = {ptr, old_word};
+}
+
+void UndoLog::revert() {
+    Batch batch;
+    for (u32 i = m_count; i > 0; i--) {
+        const UndoEntry& entry = m_entries[i - 1];
+        if (*entry.ptr == entry.old_word) continue;
+        *entry.ptr = entry.old_word;
+        clear_dc_ic_cache(entry.ptr, sizeof(u32));
+    }
+}
+
+void UndoLog::clear() {
+    if (m_entries) heap::free(m_entries);
+    m_entries = nullptr;
+    m_count = 0;
+    m_capacity = 0;
+    m_complete = true;
+}
+
+void set_undo_log(UndoLog* log) {
+    s_undo_log = log;
+}
+
+Batch::Batch() : m_outer_log(s_undo_log) {
+    begin_deferred_flush();
+}
+
+Batch::Batch(UndoLog& log) : m_outer_log(s_undo_log) {
+    s_undo_log = &log;
+    begin_deferred_flush();
+}
+
+Batch::~Batch() {
+    end_deferred_flush();
+    s_undo_log = m_outer_log;
+}
+
+void begin_deferred_flush() {
+    s_defer_depth++;
+}
+
+void end_deferred_flush() {
+    if (s_defer_depth == 0 || --s_defer_depth > 0) return;
+
+    // Insertion sort, so runs of adjacent lines can be flushed with one call
+    for (u32 i = 1; i < s_dirty_line_count; i++) {
+        u32 line = s_dirty_lines[i];
+        u32 j = i;
+        while (j > 0 && s_dirty_lines[j - 1] > line) {
+            s_dirty_lines[j] = s_dirty_lines[j - 1];
+            j--;
+        }
+        s_dirty_lines[j] = line;
+    }
+
+    u32 i = 0;
+    while (i < s_dirty_line_count) {
+        u32 start = s_dirty_lines[i];
+        u32 end = start + CACHE_LINE_SIZE;
+        for (i++; i < s_dirty_line_count && s_dirty_lines[i] == end; i++) {
+            end += CACHE_LINE_SIZE;
+        }
+        flush_range(reinterpret_cast<void*>(start), end - start);
+    }
+    s_dirty_line_count = 0;
+}
+
 u32 write_branch(void* ptr, void* destination) {
     u32 branch = 0x48000000;// b
     return write_branch_main(ptr, destination, branch);
@@ -18,79 +145,325 @@ u32 write_branch_bl(void* ptr, void* destination) {
 
 u32 write_blr(void* ptr) { return write_word(ptr, 0x4e800020); }
 
-u32 write_branch_main(void* ptr, void* destination, u32 branch) {
+static u32 branch_word(void* ptr, void* destination, u32 branch) {
     u32 delta = reinterpret_cast<u32>(destination) - reinterpret_cast<u32>(ptr);
+    return branch | (delta & 0x03FFFFFC);
+}
 
-    branch |= (delta & 0x03FFFFFC);
+u32 write_branch_main(void* ptr, void* destination, u32 branch) {
+    return write_word(ptr, branch_word(ptr, destination, branch));
+}
 
+static u32 write_word_logged(void* ptr, u32 data, UndoLog* undo_log) {
     u32* p = reinterpret_cast<u32*>(ptr);
     u32 orig_word = *p;
-    *p = branch;
+    if (orig_word == data) return orig_word;
 
+    if (undo_log) undo_log->record(p, orig_word);
+    *p = data;
     clear_dc_ic_cache(ptr, sizeof(u32));
 
     return orig_word;
 }
 
 u32 write_word(void* ptr, u32 data) {
-    u32* p = reinterpret_cast<u32*>(ptr);
-    u32 orig_word = *p;
-    *p = data;
-    clear_dc_ic_cache(ptr, sizeof(u32));
-
-    return orig_word;
+    return write_word_logged(ptr, data, s_undo_log);
 }
 
 u32 write_nop(void* ptr) { return write_word(ptr, 0x60000000); }
 
-void hook_function_internal(void* func, void* dest) {
-    // Branch directly to the destination function from the original function,
-    // leaving no option to call the original function
-    u32* instructions = static_cast<u32*>(func);
-    write_branch(&instructions[0], dest);
+bool apply_table(const Table& table) {
+    for (u32 i = 0; i < table.count; i++) {
+        const TableEntry& entry = table.entries[i];
+        u32 word = *reinterpret_cast<u32*>(entry.addr);
+        // Already patched is fine, the tickable may have been enabled again
+        if ((word & entry.mask) != (entry.expected & entry.mask) && word != entry.new_word) {
+            mkb::OSReport("[wsmod] Unexpected word %08x at %08x\n", word, entry.addr);
+            return false;
+        }
+    }
+
+    Batch batch;
+    for (u32 i = 0; i < table.count; i++) {
+        write_word(reinterpret_cast<void*>(table.entries[i].addr), table.entries[i].new_word);
+    }
+    return true;
 }
 
-void hook_function_internal(void* func, void* dest, u32* tramp_instrs, void** tramp_dest) {
-    u32* func_instrs = static_cast<u32*>(func);
+/*
+ * Every hooked function along with its hooks, sorted in call order. The first hook is branched to from the
+ * function's first instruction, and each hook's trampoline leads to the next hook. The last one leads to the original
+ * function, or to whatever another mod hooked it with before we did.
+ */
+static constexpr u32 MAX_HOOKED_FUNCTIONS = 32;
+static constexpr u32 MAX_HOOKS_PER_FUNCTION = 4;
 
-    constexpr u32 B_OPCODE_MASK = 0xFC000000;
+struct Hook {
+    void* dest;
+    void** tramp_dest;// nullptr if the hook never calls the next one
+    s32 priority;
+    const char* owner;
+#ifdef TICKABLE_PROFILE
+    HookStats* stats;
+#endif
+};
+
+struct HookedFunction {
+    u32* func;
+    u32 orig_instrs[2];// Overwritten instruction and branch to original hooked function
+    void* original;    // What the last hook calls
+    Hook hooks[MAX_HOOKS_PER_FUNCTION];
+    u32 hook_count;
+};
+
+static HookedFunction s_hooked_functions[MAX_HOOKED_FUNCTIONS];
+static u32 s_hooked_function_count = 0;
+static const char* s_hook_owner = nullptr;
+
+void set_hook_owner(const char* owner) {
+    s_hook_owner = owner;
+}
+
+static HookedFunction* get_hooked_function(u32* func) {
+    HookedFunction* free_slot = nullptr;
+    for (u32 i = 0; i < s_hooked_function_count; i++) {
+        if (s_hooked_functions[i].func == func) return &s_hooked_functions[i];
+        if (!s_hooked_functions[i].func && !free_slot) free_slot = &s_hooked_functions[i];
+    }
+    if (!free_slot) {
+        if (s_hooked_function_count == MAX_HOOKED_FUNCTIONS) return nullptr;
+        free_slot = &s_hooked_functions[s_hooked_function_count++];
+    }
+
+    HookedFunction& hooked = *free_slot;
+    hooked.func = func;
+    hooked.hook_count = 0;
+
+    constexpr u32 B_OPCODE_MASK = 0xFC000003;
     constexpr u32 B_OPCODE = 0x48000000;
     constexpr u32 B_DEST_MASK = 0x03FFFFFC;
 
-    if ((func_instrs[0] & B_OPCODE_MASK) == B_OPCODE) {
-        // Func has been hooked already, chain the hooks
+    if ((func[0] & B_OPCODE_MASK) == B_OPCODE) {
+        // Func has been hooked already by another mod, call its hook last
 
         // Compute dest currently branched to
-        u32 old_dest_offset = func_instrs[0] & B_DEST_MASK;
+        u32 old_dest_offset = func[0] & B_DEST_MASK;
         // Sign extend to make it actually a s32
         if (old_dest_offset & (0x02000000)) {
             old_dest_offset |= 0xFC000000;
         }
-        u32 old_dest = reinterpret_cast<u32>(func) + old_dest_offset;
+        hooked.original = reinterpret_cast<void*>(reinterpret_cast<u32>(func) + old_dest_offset);
+    }
+    else {
+        // Original instruction, and a branch to original func past hook. Not written with write_word(), so a
+        // tickable's undo log can't take the trampoline away from hooks of other tickables
+        hooked.orig_instrs[0] = func[0];
+        hooked.orig_instrs[1] = branch_word(&hooked.orig_instrs[1], &func[1], 0x48000000);
+        clear_dc_ic_cache(hooked.orig_instrs, sizeof(hooked.orig_instrs));
+
+        // The function pointer to run as the original function is the addr of the trampoline
+        // instructions array
+        hooked.original = hooked.orig_instrs;
+    }
+    return &hooked;
+}
 
-        // Hook to our new func instead
-        write_branch(&func_instrs[0], dest);
+// Point each hook's trampoline at the next hook, and the function at the first one. Without any hooks, the function
+// gets back its original first instruction, or the branch another mod hooked it with.
+static void relink(HookedFunction& hooked) {
+    for (u32 i = 0; i < hooked.hook_count; i++) {
+        const Hook& hook = hooked.hooks[i];
+        if (hook.tramp_dest) {
+            *hook.tramp_dest = i + 1 < hooked.hook_count ? hooked.hooks[i + 1].dest : hooked.original;
+        }
+    }
 
-        // Use the old hooked func as the trampoline dest
-        *tramp_dest = reinterpret_cast<void*>(old_dest);
+    u32 first_instr;
+    if (hooked.hook_count > 0) {
+        first_instr = branch_word(hooked.func, hooked.hooks[0].dest, 0x48000000);
+    }
+    else if (hooked.original == hooked.orig_instrs) {
+        first_instr = hooked.orig_instrs[0];
     }
     else {
-        // Func has not been hooked yet
+        first_instr = branch_word(hooked.func, hooked.original, 0x48000000);
+    }
+    write_word_logged(hooked.func, first_instr, nullptr);
+}
 
-        // Original instruction
-        tramp_instrs[0] = func_instrs[0];
-        clear_dc_ic_cache(tramp_instrs, sizeof(u32));
+#ifdef TICKABLE_PROFILE
+void hook_function_internal(void* func, void* dest, void** tramp_dest, s32 priority, HookStats* stats) {
+#else
+void hook_function_internal(void* func, void* dest, void** tramp_dest, s32 priority) {
+#endif
+    HookedFunction* hooked = get_hooked_function(static_cast<u32*>(func));
 
-        // Branch to original func past hook
-        write_branch(&tramp_instrs[1], &func_instrs[1]);
+    // Init functions of RELs run again whenever their REL is loaded, and may hook functions outside of it which are
+    // hooked already
+    if (hooked) {
+        for (u32 i = 0; i < hooked->hook_count; i++) {
+            if (hooked->hooks[i].dest == dest && hooked->hooks[i].tramp_dest == tramp_dest) return;
+        }
+    }
 
-        // The function pointer to run as the original function is the addr of the trampoline
-        // instructions array
-        *tramp_dest = tramp_instrs;
+    // A missing hook would leave its patch half applied, so this has to be fixed rather than tolerated
+    MOD_ASSERT_MSG(hooked, "Too many hooked functions, increase MAX_HOOKED_FUNCTIONS");
+    MOD_ASSERT_MSG(hooked->hook_count < MAX_HOOKS_PER_FUNCTION, "Too many hooks, increase MAX_HOOKS_PER_FUNCTION");
+
+    // Insert before the hooks with the same or a lower priority
+    u32 i = hooked->hook_count;
+    while (i > 0 && hooked->hooks[i - 1].priority <= priority) {
+        hooked->hooks[i] = hooked->hooks[i - 1];
+        i--;
+    }
+#ifdef TICKABLE_PROFILE
+    hooked->hooks[i] = {dest, tramp_dest, priority, s_hook_owner, stats};
+#else
+    hooked->hooks[i] = {dest, tramp_dest, priority, s_hook_owner};
+#endif
+    hooked->hook_count++;
 
-        // Write actual hook
-        write_branch(&func_instrs[0], dest);
+    relink(*hooked);
+}
+
+void forget_hooks(void* start, void* end) {
+    for (u32 i = 0; i < s_hooked_function_count; i++) {
+        HookedFunction& hooked = s_hooked_functions[i];
+        if (hooked.func >= start && hooked.func < end) {
+            // Left in place rather than compacted, as hooks may be running its trampoline
+            hooked.func = nullptr;
+            hooked.hook_count = 0;
+        }
     }
 }
 
+void remove_hooks(const char* owner) {
+    for (u32 i = 0; i < s_hooked_function_count; i++) {
+        HookedFunction& hooked = s_hooked_functions[i];
+        if (!hooked.func) continue;
+
+        u32 kept = 0;
+        for (u32 j = 0; j < hooked.hook_count; j++) {
+            if (hooked.hooks[j].owner != owner) {
+                hooked.hooks[kept++] = hooked.hooks[j];
+            }
+        }
+        if (kept == hooked.hook_count) continue;
+
+        hooked.hook_count = kept;
+        relink(hooked);
+        if (kept == 0) {
+            // The slot is free for reuse, but like with forget_hooks(), its trampoline stays intact until then
+            hooked.func = nullptr;
+        }
+    }
+}
+
+void report_hooks() {
+    mkb::OSReport("[wsmod] Hooks in call order:\n");
+    for (u32 i = 0; i < s_hooked_function_count; i++) {
+        const HookedFunction& hooked = s_hooked_functions[i];
+        if (!hooked.func) continue;
+        mkb::OSReport("[wsmod]  %08x:\n", hooked.func);
+        for (u32 j = 0; j < hooked.hook_count; j++) {
+            const Hook& hook = hooked.hooks[j];
+            const char* owner = hook.owner ? hook.owner : "wsmod";
+#ifdef TICKABLE_PROFILE
+            if (hook.stats) {
+                u32 calls = hook.stats->call_count;
+                mkb::OSReport("[wsmod]   %d %s %08x: %d calls, %.1f us total, %.2f us/call\n",
+                              hook.priority, owner, hook.dest, calls,
+                              tickable::ticks_to_us(hook.stats->ticks),
+                              calls ? tickable::ticks_to_us(hook.stats->ticks) / calls : 0.0f);
+                continue;
+            }
+#endif
+            mkb::OSReport("[wsmod]   %d %s %08x\n", hook.priority, owner, hook.dest);
+        }
+    }
+}
+
+#ifdef TICKABLE_PROFILE
+// Ticks spent in hooks called by the current hook so far, to subtract them from its own
+static u32 s_child_ticks = 0;
+
+HookTimer::HookTimer(HookStats& stats)
+    : m_stats(stats), m_start(mkb::OSGetTick()), m_outer_child_ticks(s_child_ticks) {
+    s_child_ticks = 0;
+}
+
+HookTimer::~HookTimer() {
+    u32 elapsed = mkb::OSGetTick() - m_start;
+    m_stats.call_count++;
+    m_stats.ticks += elapsed - s_child_ticks;
+    s_child_ticks = m_outer_child_ticks + elapsed;
+}
+#endif
+
+/*
+ * An instruction hook's stub. It saves r0 and lr, calls instruction_hook_common (see instruction_hook.s) with the
+ * hook, restores r0, lr and sp, and then runs the hooked instruction and branches back.
+ */
+static constexpr u32 MAX_INSTRUCTION_HOOKS = 8;
+static constexpr u32 INSTRUCTION_HOOK_FRAME_SIZE = 0x110;
+static constexpr u32 CONTEXT_OFFSET = 0x8;
+
+static_assert(offsetof(CpuContext, fpr) == 0x80);
+static_assert(offsetof(CpuContext, cr) == 0xf0);
+static_assert(offsetof(CpuContext, lr) == 0xfc);
+static_assert(CONTEXT_OFFSET + sizeof(CpuContext) == 0x108);
+
+struct InstructionHook {
+    void (*callback)(CpuContext& ctx);// Must come first, instruction_hook_common reads it
+    u32 code[13];
+    const char* owner;
+};
+
+static InstructionHook s_instruction_hooks[MAX_INSTRUCTION_HOOKS];
+static u32 s_instruction_hook_count = 0;
+
+bool has_instruction_hooks(const char* owner) {
+    for (u32 i = 0; i < s_instruction_hook_count; i++) {
+        if (s_instruction_hooks[i].owner == owner) return true;
+    }
+    return false;
+}
+
+bool hook_instruction(void* ptr, void (*callback)(CpuContext& ctx), bool replace) {
+    u32* instr = static_cast<u32*>(ptr);
+    // b and bc are relative to where they are
+    u32 opcode = *instr >> 26;
+    if (!replace && (opcode == 16 || opcode == 18)) {
+        mkb::OSReport("[wsmod] Can't hook relative branch at %08x\n", ptr);
+        return false;
+    }
+    MOD_ASSERT_MSG(s_instruction_hook_count < MAX_INSTRUCTION_HOOKS,
+                   "Too many instruction hooks, increase MAX_INSTRUCTION_HOOKS");
+
+    InstructionHook& hook = s_instruction_hooks[s_instruction_hook_count++];
+    u32 hook_addr = reinterpret_cast<u32>(&hook);
+    constexpr u32 R0_OFFSET = CONTEXT_OFFSET + offsetof(CpuContext, gpr);
+    constexpr u32 LR_OFFSET = CONTEXT_OFFSET + offsetof(CpuContext, lr);
+
+    hook.callback = callback;
+    hook.owner = s_hook_owner;
+    hook.code[0] = PPC_INSTR_STWU(PPC_R1, -INSTRUCTION_HOOK_FRAME_SIZE, PPC_R1);
+    hook.code[1] = PPC_INSTR_STW(PPC_R0, R0_OFFSET, PPC_R1);
+    hook.code[2] = PPC_INSTR_MFLR(PPC_R0);
+    hook.code[3] = PPC_INSTR_STW(PPC_R0, LR_OFFSET, PPC_R1);
+    hook.code[4] = PPC_INSTR_LIS(PPC_R0, (hook_addr >> 16));
+    hook.code[5] = PPC_INSTR_ORI(PPC_R0, PPC_R0, hook_addr);
+    hook.code[6] = branch_word(&hook.code[6], reinterpret_cast<void*>(main::instruction_hook_common), 0x48000001);
+    hook.code[7] = PPC_INSTR_LWZ(PPC_R0, LR_OFFSET, PPC_R1);
+    hook.code[8] = PPC_INSTR_MTLR(PPC_R0);
+    hook.code[9] = PPC_INSTR_LWZ(PPC_R0, R0_OFFSET, PPC_R1);
+    hook.code[10] = PPC_INSTR_ADDI(PPC_R1, PPC_R1, INSTRUCTION_HOOK_FRAME_SIZE);
+    hook.code[11] = replace ? PPC_INSTR_NOP() : *instr;
+    hook.code[12] = branch_word(&hook.code[12], &instr[1], 0x48000000);
+    clear_dc_ic_cache(hook.code, sizeof(hook.code));
+
+    write_branch(ptr, hook.code);
+    return true;
+}
+
 }// namespace patch
@@ -1,12 +1,22 @@
 #pragma once
 
 #include "mkb/mkb.h"
+#include <utility>
 
 namespace patch {
 
+// Flush the data cache and invalidate the instruction cache over the given range, so written code gets executed.
+// Between begin_deferred_flush() and end_deferred_flush(), the range is only recorded and flushed at the end instead.
 void clear_dc_ic_cache(void* ptr, u32 size);
 
+// Defer cache flushes of patch writes, so an init phase which writes many instructions flushes each cache line once.
+// Code written while deferring must not be executed before the matching end_deferred_flush(). Calls can be nested.
+// Batch (below) pairs these up for a scope.
+void begin_deferred_flush();
+void end_deferred_flush();
+
 // These return the overwritten word
+// Writing a word which already holds the value is skipped, without flushing the caches
 u32 write_branch(void* ptr, void* destination);
 u32 write_branch_bl(void* ptr, void* destination);
 u32 write_blr(void* ptr);
@@ -14,39 +24,243 @@ u32 write_branch_main(void* ptr, void* destination, u32 branch);
 u32 write_word(void* ptr, u32 data);
 u32 write_nop(void* ptr);
 
+struct UndoEntry {
+    u32* ptr;
+    u32 old_word;
+};
+
+/*
+ * Words changed through this module while the log is set with set_undo_log(), so they can be reverted later. Entries
+ * live in a heap allocation which grows as needed. Writes aren't replayed from the log, whatever wrote them runs
+ * again instead, so only the old words are kept.
+ */
+class UndoLog {
+public:
+    void record(u32* ptr, u32 old_word);
+    // Restore the old words, newest first
+    void revert();
+    // Drop all entries and free their memory
+    void clear();
+
+    u32 get_count() const { return m_count; }
+    // False if an entry couldn't be recorded because the heap was full, so reverting would be partial
+    bool is_complete() const { return m_complete; }
+
+private:
+    UndoEntry* m_entries = nullptr;
+    u16 m_count = 0;
+    u16 m_capacity = 0;
+    bool m_complete = true;
+};
+
+// Record every word changed from now on in log, or stop recording if nullptr
+void set_undo_log(UndoLog* log);
+
+/*
+ * A group of patch writes, made while the Batch is in scope. This covers write_*(), apply_table() and hooks. Their
+ * cache flushes are deferred until the Batch goes out of scope, then made once per run of adjacent cache lines.
+ * Given an undo log, the Batch also records the writes in it, so they can all be reverted in one call.
+ * Batches can be nested; an inner Batch without a log records into the outer one's.
+ */
+class Batch {
+public:
+    Batch();
+    explicit Batch(UndoLog& log);
+    ~Batch();
+
+    Batch(const Batch&) = delete;
+    Batch& operator=(const Batch&) = delete;
+
+private:
+    UndoLog* m_outer_log;
+};
+
+/*
+ * One word of a patch table. Before writing, the word at addr is compared against expected under mask, to catch
+ * patches meant for a different game region or version. Masks usually ignore register fields, so the check doesn't
+ * depend on register allocation. A mask of 0 skips the check.
+ */
+struct TableEntry {
+    u32 addr;
+    u32 expected;
+    u32 mask;
+    u32 new_word;
+};
+
+// A table of patch words, usually a constexpr array in a patch's translation unit
+struct Table {
+    const TableEntry* entries = nullptr;
+    u32 count = 0;
+
+    constexpr Table() = default;
+    template<u32 N>
+    constexpr Table(const TableEntry (&table_entries)[N]) : entries(table_entries), count(N) {}
+};
+
+// Write every word of the table. If any word matches neither its expected nor its new word, nothing is written and
+// false is returned
+bool apply_table(const Table& table);
+
+// Registers at an instruction hooked with hook_instruction(). Changes the callback makes are written back, except to
+// gpr[1] (sp). Only the volatile FPRs are included
+struct CpuContext {
+    u32 gpr[32];
+    f64 fpr[14];
+    u32 cr;
+    u32 xer;
+    u32 ctr;
+    u32 lr;
+};
+
+/*
+ * Call callback with the registers at the instruction at ptr, then run the instruction, or skip it if replace is
+ * true. The instruction is moved into a generated stub, so it can't be a relative branch. Returns false if it is.
+ * Asserts there's room for another instruction hook. Instruction hooks are permanent, remove_hooks() doesn't remove
+ * them.
+ */
+bool hook_instruction(void* ptr, void (*callback)(CpuContext& ctx), bool replace = false);
+
+// Hooks of the same function run in order of descending priority, outermost first. Hooks with the same priority run
+// newest first
+constexpr s32 DEFAULT_HOOK_PRIORITY = 0;
+
 template<typename T>
 struct Tramp {
-    u32 instrs[2];// Overwritten instruction and branch to original hooked function
-    T dest;       // Call this function to call the original hooked function
+    T dest;// Call this function to call the next hook, or the original hooked function
+};
+
+#ifdef TICKABLE_PROFILE
+// Calls of one hook, in profiling builds (`make TICKABLE_PROFILE=1`)
+struct HookStats {
+    u32 call_count = 0;
+    u32 ticks = 0;// Spent in the hook itself, not counting hooks it calls
+};
+
+// Times a hook call for as long as it's in scope
+class HookTimer {
+public:
+    explicit HookTimer(HookStats& stats);
+    ~HookTimer();
+
+private:
+    HookStats& m_stats;
+    u32 m_start;
+    u32 m_outer_child_ticks;
+};
+
+/*
+ * Hands out wrappers around hooks of type Func which time every call. Every wrapper is a separate instantiation with
+ * its own slot, as a hook's signature isn't known at runtime.
+ */
+template<typename Func>
+class HookProfiler;
+
+template<typename R, typename... Args>
+class HookProfiler<R (*)(Args...)> {
+public:
+    typedef R (*Func)(Args...);
+
+    // Returns dest unchanged with no stats if all wrappers for this signature are taken by other hooks
+    static Func wrap(Func dest, HookStats*& stats) {
+        // Hooking the same function again, after its REL was reloaded, keeps its stats
+        for (u32 slot = 0; slot < s_used_count; slot++) {
+            if (s_dests[slot] == dest) {
+                stats = &s_stats[slot];
+                return get_wrapper(slot, std::make_integer_sequence<u32, SLOT_COUNT>{});
+            }
+        }
+        if (s_used_count == SLOT_COUNT) {
+            stats = nullptr;
+            return dest;
+        }
+        u32 slot = s_used_count++;
+        s_dests[slot] = dest;
+        stats = &s_stats[slot];
+        return get_wrapper(slot, std::make_integer_sequence<u32, SLOT_COUNT>{});
+    }
+
+private:
+    static constexpr u32 SLOT_COUNT = 8;
+
+    template<u32 Slot>
+    static R call(Args... args) {
+        HookTimer timer(s_stats[Slot]);
+        return s_dests[Slot](args...);
+    }
+
+    template<u32... Slots>
+    static Func get_wrapper(u32 slot, std::integer_sequence<u32, Slots...>) {
+        static constexpr Func WRAPPERS[] = {&call<Slots>...};
+        return WRAPPERS[slot];
+    }
+
+    static inline Func s_dests[SLOT_COUNT] = {};
+    static inline HookStats s_stats[SLOT_COUNT] = {};
+    static inline u32 s_used_count = 0;
 };
+#endif
+
+// Attribute hooks installed from now on to owner in report_hooks() and remove_hooks(), or to the mod itself if
+// nullptr. Owners are compared by pointer.
+void set_hook_owner(const char* owner);
+
+// Whether owner installed any instruction hooks, which can't be removed
+bool has_instruction_hooks(const char* owner);
+
+// Remove the function hooks owner installed. The other hooks of the same functions stay linked, and a function's
+// first instruction is restored once it has none left. Branches to hooked functions aren't recorded in undo logs, as
+// they're shared by every hook of the function, so this is how hooks are taken out.
+void remove_hooks(const char* owner);
 
-void hook_function_internal(void* function, void* dest);
-void hook_function_internal(void* func, void* dest, u32* tramp_instrs, void** tramp_dest);
+// Print every hooked function with its hooks in call order to the console
+void report_hooks();
+
+// Forget hooks of functions in [start, end), call when a REL is unloaded or loaded there. Reloaded code can then be
+// hooked afresh, instead of adding to hooks which no longer run
+void forget_hooks(void* start, void* end);
+
+#ifdef TICKABLE_PROFILE
+void hook_function_internal(void* func, void* dest, void** tramp_dest, s32 priority, HookStats* stats);
+
+template<typename Func>
+void hook_function_typed(Func func, Func dest, void** tramp_dest, s32 priority) {
+    HookStats* stats;
+    Func wrapped = HookProfiler<Func>::wrap(dest, stats);
+    hook_function_internal(reinterpret_cast<void*>(func), reinterpret_cast<void*>(wrapped), tramp_dest, priority,
+                           stats);
+}
+#else
+void hook_function_internal(void* func, void* dest, void** tramp_dest, s32 priority);
+
+template<typename Func>
+void hook_function_typed(Func func, Func dest, void** tramp_dest, s32 priority) {
+    hook_function_internal(reinterpret_cast<void*>(func), reinterpret_cast<void*>(dest), tramp_dest, priority);
+}
+#endif
 
 /**
  * Run function `dest` in place of function `func`.
  *
- * Use this version if you don't wish to call the original hooked function again.
+ * Use this version if you don't wish to call the original hooked function again. Hooks of `func` with a lower
+ * priority won't run either.
  */
 template<typename Func, typename Dest>
-void hook_function(Func func, Dest dest) {
+void hook_function(Func func, Dest dest, s32 priority = DEFAULT_HOOK_PRIORITY) {
     // static_cast is to cast captureless lambda to function pointer and check that function types
     // are compatible
-    hook_function_internal(reinterpret_cast<void*>(func),
-                           reinterpret_cast<void*>(static_cast<Func>(dest)));
+    hook_function_typed<Func>(func, static_cast<Func>(dest), nullptr, priority);
 }
 
 /**
  * Run function `dest` in place of function `func`, and fill out the given trampoline
- * such that the original function `func` may still be called.
+ * such that the next hook of `func`, or the original function `func`, may still be called.
  */
 template<typename TrampFunc, typename Func, typename Dest>
-void hook_function(Tramp<TrampFunc>& tramp, Func func, Dest dest) {
+void hook_function(Tramp<TrampFunc>& tramp, Func func, Dest dest, s32 priority = DEFAULT_HOOK_PRIORITY) {
     // static_cast is to cast captureless lambda to function pointer and check that function types
     // are compatible
-    hook_function_internal(reinterpret_cast<void*>(static_cast<TrampFunc>(func)),
-                           reinterpret_cast<void*>(static_cast<TrampFunc>(dest)), tramp.instrs,
-                           reinterpret_cast<void**>(&tramp.dest));
+    hook_function_typed<TrampFunc>(static_cast<TrampFunc>(func), static_cast<TrampFunc>(dest),
+                                   reinterpret_cast<void**>(&tramp.dest), priority);
 }
 
 }// namespace patch
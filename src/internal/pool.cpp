@@ -0,0 +1,74 @@
+#include "pool.h"
+
+#include "heap.h"
+
+namespace heap {
+
+// Block sizes must stay in increasing order, slab_alloc() picks the first one large enough which isn't full.
+// Each slab's storage is only allocated from the mod heap the first time it's used. A slab is 512 bytes, what 8 small
+// objects take up as heap chunks, so at most 2 KB is held even if every slab ends up in use.
+static BlockPool s_slabs[] = {
+    {16, 32},
+    {32, 16},
+    {64, 8},
+    {128, 4},
+};
+
+bool BlockPool::make_storage() {
+    m_storage = static_cast<u8*>(heap::alloc(m_block_size * m_block_count));
+    if (!m_storage) return false;
+
+    // Thread the free list through the blocks in address order
+    m_free_list = nullptr;
+    for (u32 i = m_block_count; i > 0; i--) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(m_storage + (i - 1) * m_block_size);
+        block->next = m_free_list;
+        m_free_list = block;
+    }
+    m_free_count = m_block_count;
+    return true;
+}
+
+void* BlockPool::alloc() {
+    if (!m_storage && !make_storage()) return nullptr;
+    if (!m_free_list) return nullptr;
+
+    FreeBlock* block = m_free_list;
+    m_free_list = block->next;
+    m_free_count--;
+    return block;
+}
+
+bool BlockPool::free(void* ptr) {
+    if (!m_storage || !owns(ptr)) return false;
+
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    block->next = m_free_list;
+    m_free_list = block;
+    m_free_count++;
+    return true;
+}
+
+void* slab_alloc(u32 size) {
+    for (BlockPool& slab: s_slabs) {
+        if (size > slab.get_block_size()) continue;
+
+        // A full slab spills over into the next larger one
+        void* ptr = slab.alloc();
+        if (ptr) {
+            // Zeroed like heap::alloc, so callers don't see a difference
+            mkb::memset(ptr, 0, slab.get_block_size());
+            return ptr;
+        }
+    }
+    return nullptr;
+}
+
+bool slab_free(void* ptr) {
+    for (BlockPool& slab: s_slabs) {
+        if (slab.free(ptr)) return true;
+    }
+    return false;
+}
+
+}// namespace heap
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "mkb/mkb.h"
+
+namespace heap {
+
+/*
+ * A fixed number of equally sized blocks, carved out of the mod heap in a single allocation the first time a
+ * block is requested. Free blocks form an intrusive singly linked list, so allocating and freeing are constant
+ * time and blocks don't carry a chunk header of their own.
+ */
+class BlockPool {
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+public:
+    // Blocks are rounded up to a multiple of 4 bytes, so the free list links stay aligned
+    constexpr BlockPool(u32 block_size, u32 block_count)
+        : m_block_size((block_size + alignof(FreeBlock) - 1) & ~(alignof(FreeBlock) - 1)),
+          m_block_count(block_count) {}
+
+    // Returns nullptr if the pool is exhausted, or its storage couldn't be allocated
+    void* alloc();
+
+    // Returns false if ptr doesn't belong to this pool
+    bool free(void* ptr);
+
+    bool owns(const void* ptr) const {
+        u32 ptr_raw = reinterpret_cast<u32>(ptr);
+        u32 storage_raw = reinterpret_cast<u32>(m_storage);
+        return ptr_raw - storage_raw < m_block_size * m_block_count;
+    }
+
+    u32 get_block_size() const { return m_block_size; }
+    u32 get_free_count() const { return m_storage ? m_free_count : m_block_count; }
+
+private:
+    bool make_storage();
+
+    u32 m_block_size;
+    u32 m_block_count;
+    u8* m_storage = nullptr;
+    FreeBlock* m_free_list = nullptr;
+    u32 m_free_count = 0;
+};
+
+/*
+ * Small untyped allocations, served from 16/32/64/128-byte slabs. Used by operator new.
+ */
+
+// Returns nullptr if size is too large for any slab, or every slab large enough is full
+void* slab_alloc(u32 size);
+
+// Returns false if ptr wasn't allocated from a slab
+bool slab_free(void* ptr);
+
+}// namespace heap
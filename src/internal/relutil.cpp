@@ -44,6 +44,24 @@ struct RelHeader {
 };
 static_assert(sizeof(RelHeader) == 0x4C);
 
+struct SectionInfo {
+    u32 offset;// Address once linked, with the lowest bit set for executable sections
+    u32 size;
+};
+static_assert(sizeof(SectionInfo) == 0x8);
+
+void* compute_rel_sections_end(void* module) {
+    RelHeader* header = static_cast<RelHeader*>(module);
+    SectionInfo* sections = static_cast<SectionInfo*>(header->section_info_offset);
+    u32 end = reinterpret_cast<u32>(module);
+    for (u32 i = 0; i < header->num_sections; i++) {
+        u32 addr = sections[i].offset & ~1;
+        if (i == header->bss_section || addr == 0) continue;
+        if (addr + sections[i].size > end) end = addr + sections[i].size;
+    }
+    return reinterpret_cast<void*>(end);
+}
+
 void* compute_mainloop_reldata_boundary() {
     RelHeader* module = *reinterpret_cast<RelHeader**>(0x800030C8);
     for (u32 imp_idx = 0; imp_idx * sizeof(Imp) < module->imp_size; imp_idx++) {
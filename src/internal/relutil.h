@@ -8,4 +8,10 @@ namespace relutil {
  */
 void* compute_mainloop_reldata_boundary();
 
+/*
+ * Returns one past the last address of the sections of a linked REL module, other than its bss, which is allocated
+ * separately.
+ */
+void* compute_rel_sections_end(void* module);
+
 }// namespace relutil
\ No newline at end of file
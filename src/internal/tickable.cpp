@@ -1,5 +1,7 @@
 #include "tickable.h"
+#include "internal/draw.h"
 #include "internal/patch.h"
+#include "internal/relutil.h"
 
 #include "etl/iterator.h"
 #include "log.h"
@@ -8,7 +10,52 @@
 
 namespace tickable {
 
+#ifdef TICKABLE_PROFILE
+void CallbackProfile::record(u32 ticks) {
+    if (ticks < window_min) window_min = ticks;
+    if (ticks > window_max) window_max = ticks;
+    window_total += ticks;
+    window_count++;
+}
+
+void CallbackProfile::end_window() {
+    if (window_count > 0) {
+        min = window_min;
+        avg = window_total / window_count;
+        max = window_max;
+    }
+    window_min = 0xFFFFFFFF;
+    window_max = 0;
+    window_total = 0;
+    window_count = 0;
+}
+
+f32 ticks_to_us(u32 ticks) {
+    // The timebase runs at a quarter of the bus clock
+    return static_cast<f32>(ticks) * 4000000.0f / mkb::BUS_CLOCK_SPEED;
+}
+#endif
+
+static void call_init(Tickable& tickable, void (*init_func)()) {
+#ifdef TICKABLE_PROFILE
+    mkb::OSTick start = mkb::OSGetTick();
+    init_func();
+    tickable.profile.init_ticks += mkb::OSGetTick() - start;
+#else
+    init_func();
+#endif
+}
+
+// Call an init function, recording the words it patches in undo_log and attributing its hooks to the tickable
+static void call_init_logged(Tickable& tickable, void (*init_func)(), patch::UndoLog& undo_log) {
+    patch::Batch batch(undo_log);
+    patch::set_hook_owner(tickable.name);
+    call_init(tickable, init_func);
+    patch::set_hook_owner(nullptr);
+}
+
 void TickableManager::push(Tickable* tickable) {
+    MOD_ASSERT_MSG(!m_tickables.full(), "Too many tickables, increase PATCH_CAPACITY");
     auto tick_ptr = etl::unique_ptr<Tickable>(tickable);
     m_tickables.push_back(std::move(tick_ptr));
 }
@@ -17,11 +64,115 @@ const TickableManager::TickableVec& TickableManager::get_tickables() const {
     return m_tickables;
 }
 
-void TickableManager::init() const {
+void TickableManager::rebuild_dispatch() {
+    m_tick_count = 0;
+    m_disp_count = 0;
+    m_gated_count = 0;
+    for (const auto& tickable: m_tickables) {
+        if (!tickable->enabled) continue;
+        if (tickable->active_in) {
+            m_gated[m_gated_count++] = tickable.get();
+            if (!tickable->in_active_mode) continue;
+        }
+        if (tickable->tick) {
+#ifdef TICKABLE_PROFILE
+            m_tick_owners[m_tick_count] = tickable.get();
+#endif
+            m_tick_funcs[m_tick_count++] = tickable->tick;
+        }
+        if (tickable->disp) {
+#ifdef TICKABLE_PROFILE
+            m_disp_owners[m_disp_count] = tickable.get();
+#endif
+            m_disp_funcs[m_disp_count++] = tickable->disp;
+        }
+    }
+}
+
+void TickableManager::update_modes() {
+    if (mkb::main_mode == m_main_mode && mkb::sub_mode == m_sub_mode) return;
+    m_main_mode = mkb::main_mode;
+    m_sub_mode = mkb::sub_mode;
+
+    bool changed = false;
+    for (u32 i = 0; i < m_gated_count; i++) {
+        Tickable& tickable = *m_gated[i];
+        bool active = tickable.active_in(m_main_mode, m_sub_mode);
+        if (active == tickable.in_active_mode) continue;
+
+        tickable.in_active_mode = active;
+        changed = true;
+        void (*transition_func)() = active ? tickable.on_enter : tickable.on_exit;
+        if (transition_func) {
+            call_init(tickable, transition_func);
+        }
+    }
+    if (changed) {
+        rebuild_dispatch();
+    }
+}
+
+#ifdef TICKABLE_PROFILE
+void TickableManager::tick() {
+    update_modes();
+    for (u32 i = 0; i < m_tick_count; i++) {
+        mkb::OSTick start = mkb::OSGetTick();
+        m_tick_funcs[i]();
+        m_tick_owners[i]->profile.tick.record(mkb::OSGetTick() - start);
+    }
+
+    m_profile_frame++;
+    if (m_profile_frame == PROFILE_WINDOW) {
+        m_profile_frame = 0;
+        for (const auto& tickable: m_tickables) {
+            tickable->profile.tick.end_window();
+            tickable->profile.disp.end_window();
+        }
+    }
+}
+
+void TickableManager::disp() const {
+    for (u32 i = 0; i < m_disp_count; i++) {
+        mkb::OSTick start = mkb::OSGetTick();
+        m_disp_funcs[i]();
+        m_disp_owners[i]->profile.disp.record(mkb::OSGetTick() - start);
+    }
+}
+
+void TickableManager::report_profile() const {
+    mkb::OSReport("[wsmod] Tickable timings in us over the last %d frames (min/avg/max):\n", PROFILE_WINDOW);
+    for (const auto& tickable: m_tickables) {
+        if (!tickable->enabled) continue;
+
+        const TickableProfile& p = tickable->profile;
+        mkb::OSReport("[wsmod]  %s: tick %.1f/%.1f/%.1f disp %.1f/%.1f/%.1f init %.1f\n",
+                      tickable->name,
+                      ticks_to_us(p.tick.min), ticks_to_us(p.tick.avg), ticks_to_us(p.tick.max),
+                      ticks_to_us(p.disp.min), ticks_to_us(p.disp.avg), ticks_to_us(p.disp.max),
+                      ticks_to_us(p.init_ticks));
+    }
+}
+#else
+void TickableManager::tick() {
+    update_modes();
+    for (u32 i = 0; i < m_tick_count; i++) {
+        m_tick_funcs[i]();
+    }
+}
+
+void TickableManager::disp() const {
+    for (u32 i = 0; i < m_disp_count; i++) {
+        m_disp_funcs[i]();
+    }
+}
+#endif
+
+void TickableManager::init() {
     static patch::Tramp<decltype(&mkb::draw_debugtext)> s_draw_debugtext_tramp;
     static patch::Tramp<decltype(&mkb::load_additional_rel)> s_load_additional_rel_tramp;
 
     // Call init_main_loop on all tickables that have been enabled
+    patch::Batch batch;
     for (const auto& tickable: m_tickables) {
         // Print a message to our log on load
         if (tickable->description != nullptr) {
@@ -45,12 +196,13 @@ void TickableManager::init() const {
             }
         }
 
-        // Execute the main_loop init func, if it exists
-        if (tickable->enabled && tickable->init_main_loop) {
-            // mkb::OSReport("Running init_main_loop for %s\n", tickable->name);
-            (*tickable->init_main_loop)();
+        // Apply the main_loop patches and execute the main_loop init func, if they exist
+        if (tickable->enabled) {
+            init_main_loop(*tickable);
         }
     }
+    rebuild_dispatch();
+
     // Hook for mkb::draw_debugtext
     patch::hook_function(s_draw_debugtext_tramp, mkb::draw_debugtext, []() {
         // Drawing hook for UI elements.
@@ -58,12 +210,7 @@ void TickableManager::init() const {
         // which is called at the end of smb2's function which draws the UI in general.
 
         // Disp functions (REL patches)
-        for (const auto& tickable: get_tickable_manager().get_tickables()) {
-            if (tickable->enabled && tickable->disp) {
-                // mkb::OSReport("Running disp for %s\n", tickable->name);
-                (*tickable->disp)();
-            }
-        }
+        get_tickable_manager().disp();
         s_draw_debugtext_tramp.dest();
     });
 
@@ -73,35 +220,162 @@ void TickableManager::init() const {
         mkb::load_additional_rel, [](char* rel_filepath, mkb::RelBufferInfo* rel_buffer_ptrs) {
             s_load_additional_rel_tramp.dest(rel_filepath, rel_buffer_ptrs);
 
-            // Functions that need to be initialized when mkb2.main_game.rel is loaded
+            // Functions of the previous REL, and whatever the new one was loaded over, aren't hooked anymore
+            static void* s_rel_start = nullptr;
+            static void* s_rel_end = nullptr;
+            patch::forget_hooks(s_rel_start, s_rel_end);
+            s_rel_start = rel_buffer_ptrs->rel_buffer;
+            s_rel_end = relutil::compute_rel_sections_end(s_rel_start);
+            patch::forget_hooks(s_rel_start, s_rel_end);
+
+            // Functions that need to be initialized when mkb2.main_game.rel or mkb2.sel_ngc.rel is loaded
+            LoadedRel rel = LoadedRel::None;
             if (STREQ(rel_filepath, "mkb2.main_game.rel")) {
-                for (const auto& tickable: get_tickable_manager().get_tickables()) {
-                    if (tickable->enabled && tickable->init_main_game) {
-                        // mkb::OSReport("Running init_main_game for %s\n", tickable->name);
-                        (*tickable->init_main_game)();
-                    }
-                }
+                rel = LoadedRel::MainGame;
             }
-
-            // Functions that need to be initialized when mkb2.sel_ngc.rel is loaded
             else if (STREQ(rel_filepath, "mkb2.sel_ngc.rel")) {
-                for (const auto& tickable: get_tickable_manager().get_tickables()) {
-                    if (tickable->enabled && tickable->init_sel_ngc) {
-                        // mkb::OSReport("Running init_sel_ngc for %s\n", tickable->name);
-                        (*tickable->init_sel_ngc)();
-                    }
-                }
+                rel = LoadedRel::SelNgc;
             }
+            get_tickable_manager().on_rel_loaded(rel);
         });
 }
 
+void TickableManager::init_main_loop(Tickable& tickable) {
+    if (tickable.main_loop_patches.count > 0) {
+        patch::Batch batch(tickable.main_loop_undo);
+        if (!patch::apply_table(tickable.main_loop_patches)) {
+            // On screen too, as a patch silently missing would be mistaken for it not working
+            mkb::OSReport("[wsmod] %s doesn't match this version of the game, not applied\n", tickable.name);
+            draw::notify(draw::RED, "%s doesn't match this game", tickable.name);
+        }
+    }
+    if (tickable.init_main_loop) {
+        // mkb::OSReport("Running init_main_loop for %s\n", tickable.name);
+        call_init_logged(tickable, tickable.init_main_loop, tickable.main_loop_undo);
+    }
+}
+
+void TickableManager::on_rel_loaded(LoadedRel rel) {
+    m_loaded_rel = rel;
+
+    // The previous REL was unloaded along with the words its init functions patched
+    patch::Batch batch;
+    for (const auto& tickable: m_tickables) {
+        tickable->rel_undo.clear();
+        if (tickable->enabled) {
+            init_rel(*tickable);
+        }
+    }
+}
+
+void TickableManager::init_rel(Tickable& tickable) {
+    void (*init_func)() = nullptr;
+    if (m_loaded_rel == LoadedRel::MainGame) {
+        init_func = tickable.init_main_game;
+    }
+    else if (m_loaded_rel == LoadedRel::SelNgc) {
+        init_func = tickable.init_sel_ngc;
+    }
+
+    if (init_func) {
+        call_init_logged(tickable, init_func, tickable.rel_undo);
+    }
+}
+
+bool TickableManager::enable(const char* name) {
+    Tickable* tickable = find(name);
+    if (!tickable) return false;
+    if (tickable->enabled) return true;
+
+    // Running the init functions again also reinstalls the hooks disable() removed, in priority order
+    tickable->enabled = true;
+    {
+        patch::Batch batch;
+        init_main_loop(*tickable);
+        init_rel(*tickable);
+    }
+
+    // Re-evaluate mode predicates on the next tick, as this one wasn't tracking them while disabled
+    m_main_mode = 0xFFFFFFFF;
+    rebuild_dispatch();
+    return true;
+}
+
+bool TickableManager::disable(const char* name) {
+    Tickable* tickable = find(name);
+    if (!tickable) return false;
+    if (!tickable->enabled) return true;
+    if (!tickable->main_loop_undo.is_complete() || !tickable->rel_undo.is_complete()) {
+        mkb::OSReport("[wsmod] Can't disable %s, its patches weren't fully recorded\n", tickable->name);
+        return false;
+    }
+    if (patch::has_instruction_hooks(tickable->name)) {
+        mkb::OSReport("[wsmod] Can't disable %s, its instruction hooks can't be removed\n", tickable->name);
+        return false;
+    }
+
+    if (tickable->in_active_mode) {
+        tickable->in_active_mode = false;
+        if (tickable->on_exit) {
+            call_init(*tickable, tickable->on_exit);
+        }
+    }
+
+    {
+        patch::Batch batch;
+        tickable->rel_undo.revert();
+        tickable->main_loop_undo.revert();
+        patch::remove_hooks(tickable->name);
+    }
+    // Enabling it again records its patches afresh
+    tickable->rel_undo.clear();
+    tickable->main_loop_undo.clear();
+
+    tickable->enabled = false;
+    rebuild_dispatch();
+    return true;
+}
+
 bool TickableManager::get_tickable_status(const char* name) const {
-    for (const auto& t: m_tickables) {
-        if (strcmp(t->name, name) == 0) {
-            return t->enabled;
+    Tickable* t = find(name);
+    return t && t->enabled;
+}
+
+void TickableManager::sort_by_name() const {
+    // Insertion sort, there aren't many tickables and this only happens after tickables are pushed
+    m_by_name_count = 0;
+    for (const auto& tickable: m_tickables) {
+        if (tickable->name == nullptr) continue;
+
+        u32 i = m_by_name_count++;
+        while (i > 0 && mkb::strcmp(const_cast<char*>(m_by_name[i - 1]->name), const_cast<char*>(tickable->name)) > 0) {
+            m_by_name[i] = m_by_name[i - 1];
+            i--;
+        }
+        m_by_name[i] = tickable.get();
+    }
+    m_sorted_tickable_count = m_tickables.size();
+}
+
+Tickable* TickableManager::find(const char* name) const {
+    if (m_sorted_tickable_count != m_tickables.size()) {
+        sort_by_name();
+    }
+
+    u32 lo = 0;
+    u32 hi = m_by_name_count;
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        s32 cmp = mkb::strcmp(const_cast<char*>(m_by_name[mid]->name), const_cast<char*>(name));
+        if (cmp == 0) return m_by_name[mid];
+        if (cmp < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
         }
     }
-    return false;
+    return nullptr;
 }
 
 TickableManager& get_tickable_manager() {
@@ -3,6 +3,7 @@
 #include "etl/memory.h"
 #include "etl/optional.h"
 #include "etl/vector.h"
+#include "internal/patch.h"
 #include "mkb.h"
 
 #define _TOKEN_CONCAT(x, y) x##y
@@ -26,9 +27,40 @@
 
 namespace tickable {
 
-// Capacity of the tickable manager vector, increase if needed
+// Capacity of the tickable manager vector, increase if needed, push() asserts it's enough
 // This only stores pointers, so memory impact should be low
-constexpr size_t PATCH_CAPACITY = 32;
+constexpr size_t PATCH_CAPACITY = 48;
+
+#ifdef TICKABLE_PROFILE
+// Profiling builds (`make TICKABLE_PROFILE=1`) time every tickable callback over windows of this many frames
+constexpr u32 PROFILE_WINDOW = 60;
+
+// Timings of one kind of callback, in timebase ticks
+struct CallbackProfile {
+    // Over the last complete window
+    u32 min = 0;
+    u32 avg = 0;
+    u32 max = 0;
+
+    // Over the current window
+    u32 window_min = 0xFFFFFFFF;
+    u32 window_max = 0;
+    u32 window_total = 0;
+    u32 window_count = 0;
+
+    void record(u32 ticks);
+    void end_window();
+};
+
+struct TickableProfile {
+    CallbackProfile tick;
+    CallbackProfile disp;
+    u32 init_ticks = 0;// Summed over all init and mode transition callbacks run so far
+};
+
+// Convert timebase ticks to microseconds
+f32 ticks_to_us(u32 ticks);
+#endif
 
 // Represents a patch, or code that ticks every frame
 struct Tickable {
@@ -38,11 +70,29 @@ struct Tickable {
     etl::optional<int> active_value;
     etl::optional<int> lower_bound;
     etl::optional<int> upper_bound;
+    patch::Table main_loop_patches;// Applied along with init_main_loop, before it
     void (*init_main_loop)() = nullptr;
     void (*init_main_game)() = nullptr;
     void (*init_sel_ngc)() = nullptr;
     void (*disp)() = nullptr;
     void (*tick)() = nullptr;
+
+    // Optional mode predicate. If set, tick/disp only run while it returns true, and on_enter/on_exit are called
+    // when a main_mode/sub_mode change makes it flip, so patches can be applied on transitions instead of every frame
+    bool (*active_in)(mkb::MainMode main_mode, mkb::SubMode sub_mode) = nullptr;
+    void (*on_enter)() = nullptr;
+    void (*on_exit)() = nullptr;
+
+    // Whether active_in returned true for the current modes, maintained by the tickable manager
+    bool in_active_mode = false;
+
+    // Words patched by init_main_loop, and by the init function of the currently loaded main_game/sel_ngc REL,
+    // so the tickable can be disabled at runtime. Maintained by the tickable manager
+    patch::UndoLog main_loop_undo;
+    patch::UndoLog rel_undo;
+#ifdef TICKABLE_PROFILE
+    TickableProfile profile;
+#endif
 };
 
 // Manages all tickables
@@ -51,11 +101,76 @@ public:
     typedef etl::vector<etl::unique_ptr<Tickable>, PATCH_CAPACITY> TickableVec;
     const TickableVec& get_tickables() const;
     bool get_tickable_status(const char* name) const;
+    // Find a tickable by name with a binary search, or nullptr if there isn't one
+    Tickable* find(const char* name) const;
     void push(Tickable* tickable);
-    void init() const;
+    void init();
+
+    // Fire mode transitions, then call the tick functions of all enabled tickables
+    void tick();
+    // Call the disp functions of all enabled tickables
+    void disp() const;
+
+    // Rebuild the tick/disp dispatch lists, call after changing whether tickables are enabled after init()
+    void rebuild_dispatch();
+
+    // Enable or disable a tickable at runtime. Disabling reverts the words its init functions patched and removes
+    // its function hooks, and enabling runs its init functions again, so they must be safe to run more than once.
+    // State a tickable changes without going through patch:: isn't restored, and reverting a word another enabled
+    // tickable patched too undoes that tickable's write as well. Returns false if there's no such tickable, or if
+    // its patches can't be fully reverted, such as when it installed instruction hooks.
+    bool enable(const char* name);
+    bool disable(const char* name);
+
+#ifdef TICKABLE_PROFILE
+    // Print the timings of every enabled tickable to the console
+    void report_profile() const;
+#endif
 
 private:
+    typedef void (*Callback)();
+
+    // The REL loaded by load_additional_rel, only one is loaded at a time
+    enum class LoadedRel {
+        None,
+        MainGame,
+        SelNgc,
+    };
+
+    void sort_by_name() const;
+    void update_modes();
+    void init_main_loop(Tickable& tickable);
+    void on_rel_loaded(LoadedRel rel);
+    void init_rel(Tickable& tickable);
+
     TickableVec m_tickables;
+
+    // Tick and disp functions of enabled tickables only, so per-frame dispatch doesn't visit the others
+    Callback m_tick_funcs[PATCH_CAPACITY];
+    u32 m_tick_count = 0;
+    Callback m_disp_funcs[PATCH_CAPACITY];
+    u32 m_disp_count = 0;
+
+    // Enabled tickables with a mode predicate, re-evaluated only when the modes change
+    Tickable* m_gated[PATCH_CAPACITY];
+    u32 m_gated_count = 0;
+    // Modes the predicates were last evaluated for, invalid until the first tick
+    mkb::MainMode m_main_mode = 0xFFFFFFFF;
+    mkb::SubMode m_sub_mode = 0xFFFFFFFF;
+
+    LoadedRel m_loaded_rel = LoadedRel::None;
+
+#ifdef TICKABLE_PROFILE
+    // Which tickable each dispatched callback belongs to
+    Tickable* m_tick_owners[PATCH_CAPACITY];
+    Tickable* m_disp_owners[PATCH_CAPACITY];
+    mutable u32 m_profile_frame = 0;
+#endif
+
+    // Tickables sorted by name, rebuilt whenever a tickable was pushed since the last lookup
+    mutable Tickable* m_by_name[PATCH_CAPACITY];
+    mutable u32 m_by_name_count = 0;
+    mutable u32 m_sorted_tickable_count = 0;
 };
 
 TickableManager& get_tickable_manager();
@@ -1,5 +1,6 @@
 #include "config/config.h"
 #include "internal/assembly.h"
+#include "internal/draw.h"
 #include "internal/heap.h"
 #include "internal/modlink.h"
 #include "internal/pad.h"
@@ -7,13 +8,17 @@
 #include "internal/tickable.h"
 #include "internal/version.h"
 #include "mkb/mkb.h"
+#include "patches/extensions/frame_time_monitor.h"
 
 namespace main {
 static patch::Tramp<decltype(&mkb::process_inputs)> s_process_inputs_tramp;
+static patch::Tramp<decltype(&mkb::draw_debugtext)> s_draw_debugtext_tramp;
 
 bool debug_mode_enabled = false;
 
 static void perform_assembly_patches() {
+    patch::Batch batch;
+
     // Inject the run function at the start of the main game loop
     patch::write_branch_bl(reinterpret_cast<void*>(0x80270700),
                            reinterpret_cast<void*>(start_main_loop_assembly));
@@ -52,14 +57,16 @@ void init() {
             // to ensure lowest input delay
 
             // Tick functions (REL patches)
-            for (const auto& tickable: tickable::get_tickable_manager().get_tickables()) {
-                if (tickable->enabled && tickable->tick) {
-                    tickable->tick();
-                }
-            }
+            tickable::get_tickable_manager().tick();
 
             pad::tick();
         });
+
+    // Messages from draw::notify(), drawn along with the debug text of the tickables
+    patch::hook_function(s_draw_debugtext_tramp, mkb::draw_debugtext, []() {
+        draw::disp();
+        s_draw_debugtext_tramp.dest();
+    });
 }
 
 /*
@@ -67,6 +74,9 @@ void init() {
  * controller inputs have been read and processed however, to ensure the lowest input delay.
  */
 void tick() {
+    frame_time_monitor::on_frame_start();
+    heap::frame_reset();
+    draw::on_frame_start();
     pad::on_frame_start();
 }
 
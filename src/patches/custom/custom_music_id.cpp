@@ -3,7 +3,7 @@
 #include "internal/assembly.h"
 #include "internal/patch.h"
 #include "internal/tickable.h"
-#include "utils/ppcutil.h"
+#include "mkb/mkb.h"
 
 namespace custom_music_id {
 
@@ -12,10 +12,14 @@ TICKABLE_DEFINITION((
         .description = "Custom music ID patch",
         .init_main_loop = init_main_loop, ))
 
-// Hooks into g_handle_world_bgm, modifies the variable for BGM ID to point to
-// the one in our stage ID ->
+// Replaces the instruction in g_handle_world_bgm which loads the BGM ID into r0
+// with a lookup in our stage ID -> BGM ID table
+static void get_bgm_id(patch::CpuContext& ctx) {
+    ctx.gpr[0] = main::bgm_id_lookup[mkb::g_current_stage_id];
+}
+
 void init_main_loop() {
-    patch::write_branch_bl(reinterpret_cast<void*>(0x802a5f08), reinterpret_cast<void*>(main::get_bgm_id_hook));
+    patch::hook_instruction(reinterpret_cast<void*>(0x802a5f08), get_bgm_id, true);
 }
 
 }// namespace custom_music_id
@@ -0,0 +1,67 @@
+#include "heap_hud.h"
+
+#ifdef HEAP_INSTRUMENT
+
+#include "internal/draw.h"
+#include "internal/heap.h"
+#include "internal/pad.h"
+#include "internal/tickable.h"
+#include "mkb/mkb.h"
+
+namespace heap_hud {
+
+// Only exists in instrumented builds, so it's always enabled rather than configured
+TICKABLE_DEFINITION((
+        .name = "heap-hud",
+        .description = "Heap usage HUD",
+        .enabled = true,
+        .disp = disp,
+        .tick = tick, ))
+
+static constexpr u32 TOP_CALLSITE_COUNT = 5;
+static constexpr s32 LINE_HEIGHT = 14;
+static constexpr s32 X = 16;
+
+void tick() {
+    // Z + D-pad Left benchmarks the allocator and prints the results to the console. The first run freezes the
+    // trace it replays, so wait until the allocations worth replaying have been made.
+    if (pad::button_chord_pressed(mkb::PAD_TRIGGER_Z, mkb::PAD_BUTTON_LEFT)) {
+        heap::run_benchmark();
+    }
+}
+
+void disp() {
+    heap::FragmentationReport report = heap::defragment_report();
+    u32 total = heap::get_total_space();
+    s32 y = draw::begin_overlay();
+
+    draw::debug_text(X, y, draw::WHITE, "Heap: %d/%d free", report.free_space, total);
+    y += LINE_HEIGHT;
+
+    // Fragmentation above a half means the largest free chunk is less than half of all free memory
+    mkb::GXColor frag_color = report.fragmentation > 0.5f ? draw::RED : draw::WHITE;
+    draw::debug_text(X, y, frag_color, "Largest: %d in %d chunks (%d%% frag)",
+                     report.largest_free, report.free_chunk_count, static_cast<s32>(report.fragmentation * 100));
+    y += LINE_HEIGHT;
+
+    draw::debug_text(X, y, draw::WHITE, "Ours: %d (peak %d)", heap::get_used_space(), heap::get_peak_used_space());
+    y += LINE_HEIGHT;
+
+    draw::debug_text(X, y, draw::WHITE, "Frame arena peak: %d", heap::get_frame_high_water());
+    y += LINE_HEIGHT;
+
+    heap::CallsiteStats top[TOP_CALLSITE_COUNT];
+    u32 count = heap::get_top_callsites(top, TOP_CALLSITE_COUNT);
+    for (u32 i = 0; i < count; i++) {
+        // Callsite 0 collects every callsite which didn't fit in the table
+        mkb::GXColor color = top[i].callsite ? draw::BLUE : draw::ORANGE;
+        draw::debug_text(X, y, color, "%08X %d in %d (peak %d)",
+                         top[i].callsite, top[i].live_bytes, top[i].live_count, top[i].peak_bytes);
+        y += LINE_HEIGHT;
+    }
+    draw::end_overlay(y);
+}
+
+}// namespace heap_hud
+
+#endif
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace heap_hud {
+
+void disp();
+void tick();
+
+}// namespace heap_hud
@@ -0,0 +1,139 @@
+#include "profiler_hud.h"
+
+#ifdef TICKABLE_PROFILE
+
+#include "internal/draw.h"
+#include "internal/pad.h"
+#include "internal/patch.h"
+#include "internal/tickable.h"
+#include "mkb/mkb.h"
+
+namespace profiler_hud {
+
+// Only exists in profiling builds, so it's always enabled rather than configured
+TICKABLE_DEFINITION((
+        .name = "profiler-hud",
+        .description = "Tickable profiler HUD",
+        .enabled = true,
+        .disp = disp,
+        .tick = tick, ))
+
+static constexpr s32 LINE_HEIGHT = 14;
+static constexpr s32 X = 16;
+
+// A whole frame at 60 fps
+static constexpr f32 FRAME_BUDGET_US = 16666.7f;
+
+// Tickables disabled from the HUD, which stay listed so they can be enabled again
+static constexpr u32 MAX_DISABLED = 8;
+static tickable::Tickable* s_disabled[MAX_DISABLED];
+static u32 s_disabled_count = 0;
+
+// Index of the selected row
+static u32 s_selected = 0;
+
+static bool disabled_here(const tickable::Tickable* tickable) {
+    for (u32 i = 0; i < s_disabled_count; i++) {
+        if (s_disabled[i] == tickable) return true;
+    }
+    return false;
+}
+
+// Tickables without tick or disp functions never show up here
+static bool is_listed(const tickable::Tickable* tickable) {
+    return (tickable->tick || tickable->disp) && (tickable->enabled || disabled_here(tickable));
+}
+
+// Returns the tickable at the given row of the list, or how many rows there are through row_count
+static tickable::Tickable* get_listed(u32 index, u32& row_count) {
+    row_count = 0;
+    for (const auto& tickable: tickable::get_tickable_manager().get_tickables()) {
+        if (!is_listed(tickable.get())) continue;
+        if (row_count == index) return tickable.get();
+        row_count++;
+    }
+    return nullptr;
+}
+
+// Disable the selected tickable to see what it costs, or enable it again
+static void toggle_selected() {
+    u32 row_count;
+    tickable::Tickable* tickable = get_listed(s_selected, row_count);
+    // Disabling the HUD itself would leave no way to enable anything again
+    if (!tickable || tickable == active_tickable_ptr) return;
+
+    tickable::TickableManager& manager = tickable::get_tickable_manager();
+    if (tickable->enabled) {
+        if (s_disabled_count == MAX_DISABLED) {
+            draw::notify(draw::RED, "Enable a tickable again first");
+            return;
+        }
+        if (!manager.disable(tickable->name)) {
+            draw::notify(draw::RED, "Can't disable %s", tickable->name);
+            return;
+        }
+        s_disabled[s_disabled_count++] = tickable;
+    }
+    else {
+        manager.enable(tickable->name);
+        for (u32 i = 0; i < s_disabled_count; i++) {
+            if (s_disabled[i] == tickable) {
+                s_disabled[i] = s_disabled[--s_disabled_count];
+                break;
+            }
+        }
+    }
+}
+
+void tick() {
+    // Z + D-pad Up dumps every tickable's and hook's timings to the console
+    if (pad::button_chord_pressed(mkb::PAD_TRIGGER_Z, mkb::PAD_BUTTON_UP)) {
+        tickable::get_tickable_manager().report_profile();
+        patch::report_hooks();
+    }
+    // Z + Y moves the selection down the list, wrapping around, and Z + X disables or enables the selected tickable
+    if (pad::button_chord_pressed(mkb::PAD_TRIGGER_Z, mkb::PAD_BUTTON_Y)) {
+        u32 row_count;
+        get_listed(0xFFFFFFFF, row_count);
+        s_selected = s_selected + 1 < row_count ? s_selected + 1 : 0;
+    }
+    if (pad::button_chord_pressed(mkb::PAD_TRIGGER_Z, mkb::PAD_BUTTON_X)) {
+        toggle_selected();
+    }
+}
+
+void disp() {
+    s32 y = draw::begin_overlay();
+    f32 total_us = 0;
+
+    draw::debug_text(X, y, draw::WHITE, "Tickable      avg/max us");
+    y += LINE_HEIGHT;
+
+    u32 row = 0;
+    for (const auto& tickable: tickable::get_tickable_manager().get_tickables()) {
+        if (!is_listed(tickable.get())) continue;
+        char cursor = row++ == s_selected ? '>' : ' ';
+        if (!tickable->enabled) {
+            draw::debug_text(X, y, draw::PURPLE, "%c%-12.12s off", cursor, tickable->name);
+            y += LINE_HEIGHT;
+            continue;
+        }
+
+        const tickable::TickableProfile& p = tickable->profile;
+        f32 avg_us = tickable::ticks_to_us(p.tick.avg + p.disp.avg);
+        f32 max_us = tickable::ticks_to_us(p.tick.max + p.disp.max);
+        total_us += avg_us;
+
+        // Anything taking over a percent of the frame deserves a look
+        mkb::GXColor color = max_us > FRAME_BUDGET_US / 100 ? draw::ORANGE : draw::BLUE;
+        draw::debug_text(X, y, color, "%c%-12.12s %.1f/%.1f", cursor, tickable->name, avg_us, max_us);
+        y += LINE_HEIGHT;
+    }
+
+    draw::debug_text(X, y, draw::WHITE, "Total avg: %.1f us of %.1f", total_us, FRAME_BUDGET_US);
+    draw::end_overlay(y + LINE_HEIGHT);
+}
+
+}// namespace profiler_hud
+
+#endif
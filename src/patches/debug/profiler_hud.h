@@ -0,0 +1,8 @@
+#pragma once
+
+namespace profiler_hud {
+
+void tick();
+void disp();
+
+}// namespace profiler_hud
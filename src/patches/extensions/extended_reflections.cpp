@@ -1,9 +1,12 @@
 #include "extended_reflections.h"
 
+#include "internal/heap.h"
 #include "internal/patch.h"
 #include "internal/tickable.h"
 #include "mkb/mkb.h"
 
+#include <cstddef>
+
 namespace extended_reflections {
 
 TICKABLE_DEFINITION((
@@ -11,69 +14,252 @@ TICKABLE_DEFINITION((
         .description = "Reflective surface enhancements",
         .init_main_loop = init_main_loop, ))
 
-float nearest_dist_to_mir, distance_to_mirror;
-Vec current_ball_position, mirror_origin, ig_init_pos, translation_factor;
-mkb::Itemgroup* active_ig;
+static constexpr u32 BALL_COUNT = 4;
+
+// A reflective model of the current stage
+struct Mirror {
+    Vec center;// Bounding sphere center, where the itemgroup starts out
+    f32 radius;
+    Vec offset;// From the itemgroup's origin to center
+    // Squared distance from the center within which no other mirror can be nearer, see build_index()
+    f32 keep_dist_sq;
+    u32 coli_header_idx;
+};
+
+// Mirrors of the current stage, sorted by center.x
+static Mirror* s_mirrors = nullptr;
+static u32 s_mirror_count = 0;
+
+// The stage the index was built for
+static mkb::StagedefFileHeader* s_indexed_stagedef = nullptr;
+static s32 s_indexed_stage_id = -1;
 
-float get_distance(Vec& vec1, Vec& vec2) {
-    float xcmp = (vec1.x - vec2.x) * (vec1.x - vec2.x);
-    float ycmp = (vec1.y - vec2.y) * (vec1.y - vec2.y);
-    float zcmp = (vec1.z - vec2.z) * (vec1.z - vec2.z);
+// Index of each ball's nearest mirror on the previous frame, or -1
+static s32 s_last_nearest[BALL_COUNT];
 
-    return mkb::math_sqrt(xcmp + ycmp + zcmp);
+static f32 get_distance_sq(const Vec& vec1, const Vec& vec2) {
+    f32 xcmp = (vec1.x - vec2.x) * (vec1.x - vec2.x);
+    f32 ycmp = (vec1.y - vec2.y) * (vec1.y - vec2.y);
+    f32 zcmp = (vec1.z - vec2.z) * (vec1.z - vec2.z);
+
+    return xcmp + ycmp + zcmp;
 }
 
-// Translates the nearest mirror from its origin to the current translation/rotation of its collision header
-void mirror_tick() {
-    mkb::Ball* ball = mkb::balls;
+static void build_index() {
+    if (s_mirrors) heap::free(s_mirrors);
+    s_mirrors = nullptr;
+    s_mirror_count = 0;
+    s_indexed_stagedef = mkb::stagedef;
+    s_indexed_stage_id = mkb::g_current_stage_id;
+    for (u32 i = 0; i < BALL_COUNT; i++) {
+        s_last_nearest[i] = -1;
+    }
+
+    u32 count = 0;
+    for (u32 col_hdr_idx = 0; col_hdr_idx < mkb::stagedef->coli_header_count; col_hdr_idx++) {
+        count += mkb::stagedef->coli_header_list[col_hdr_idx].reflective_stage_model_count;
+    }
+    if (count == 0) return;
+    s_mirrors = static_cast<Mirror*>(heap::alloc(count * sizeof(Mirror)));
+    if (!s_mirrors) return;
+
+    // Insertion sort by x, stages don't have many mirrors and this only happens on stage load
+    for (u32 col_hdr_idx = 0; col_hdr_idx < mkb::stagedef->coli_header_count; col_hdr_idx++) {
+        mkb::StagedefColiHeader* hdr = &mkb::stagedef->coli_header_list[col_hdr_idx];
+        for (u32 refl_idx = 0; refl_idx < hdr->reflective_stage_model_count; refl_idx++) {
+            mkb::GmaModel* model = hdr->reflective_stage_model_list[refl_idx].g_model_header_ptr;
+            const Vec& center = model->bound_sphere_center;
+            Mirror mirror = {center,
+                             model->bound_sphere_radius,
+                             {center.x - hdr->origin.x, center.y - hdr->origin.y, center.z - hdr->origin.z},
+                             0,
+                             col_hdr_idx};
+            u32 i = s_mirror_count++;
+            while (i > 0 && s_mirrors[i - 1].center.x > mirror.center.x) {
+                s_mirrors[i] = s_mirrors[i - 1];
+                i--;
+            }
+            s_mirrors[i] = mirror;
+        }
+    }
 
-    // Determines the nearest reflective surface to the active ball
-    for (int idx = 0; idx < 4; idx++) {
-        if (ball != nullptr && ball->status == mkb::STAT_NORMAL) {
-            for (u32 col_hdr_idx = 0; col_hdr_idx < (mkb::stagedef->coli_header_count); col_hdr_idx++) {
-                mkb::StagedefColiHeader* hdr = &mkb::stagedef->coli_header_list[col_hdr_idx];
-                for (u32 refl_idx = 0; refl_idx < hdr->reflective_stage_model_count; refl_idx++) {
-                    mkb::StagedefReflectiveStageModel* refl = &hdr->reflective_stage_model_list[refl_idx];
-                    current_ball_position = ball->pos;
-                    distance_to_mirror = get_distance(current_ball_position, refl->g_model_header_ptr->bound_sphere_center);
-
-                    if (nearest_dist_to_mir == -1.0 || distance_to_mirror < nearest_dist_to_mir) {
-                        nearest_dist_to_mir = distance_to_mirror;
-                        active_ig = &mkb::itemgroups[col_hdr_idx];
-                        mirror_origin = refl->g_model_header_ptr->bound_sphere_center;
-                        ig_init_pos = hdr->origin;
-                    }
+    // A ball within half the distance between a mirror and its nearest neighbor is nearer to that mirror than to any
+    // other, which lets the nearest mirror from the previous frame be reused without searching
+    for (u32 i = 0; i < s_mirror_count; i++) {
+        f32 neighbor_dist_sq = -1.0f;
+        for (u32 j = 0; j < s_mirror_count; j++) {
+            if (i == j) continue;
+            f32 dist_sq = get_distance_sq(s_mirrors[i].center, s_mirrors[j].center);
+            if (neighbor_dist_sq < 0 || dist_sq < neighbor_dist_sq) {
+                neighbor_dist_sq = dist_sq;
+            }
+        }
+        // (d / 2)^2 = d^2 / 4. A lone mirror is always the nearest
+        s_mirrors[i].keep_dist_sq = neighbor_dist_sq < 0 ? 3.4e38f : neighbor_dist_sq / 4;
+    }
+}
+
+// Nearest mirror to pos, starting from the one nearest on the previous frame
+static s32 find_nearest_mirror(const Vec& pos, s32 last, f32& nearest_dist_sq) {
+    s32 nearest = -1;
+    nearest_dist_sq = -1.0f;
+    if (last >= 0) {
+        f32 dist_sq = get_distance_sq(pos, s_mirrors[last].center);
+        if (dist_sq <= s_mirrors[last].keep_dist_sq) {
+            nearest_dist_sq = dist_sq;
+            return last;
+        }
+        // Still a close bound to start from, so the search below can stop early
+        nearest = last;
+        nearest_dist_sq = dist_sq;
+    }
+
+    // Search outwards from pos.x in both directions, until mirrors are further away on x alone than the nearest
+    u32 lo = 0;
+    u32 hi = s_mirror_count;
+    while (lo < hi) {
+        u32 mid = (lo + hi) / 2;
+        if (s_mirrors[mid].center.x < pos.x) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    s32 left = static_cast<s32>(lo) - 1;
+    u32 right = lo;
+    while (left >= 0 || right < s_mirror_count) {
+        if (right < s_mirror_count) {
+            f32 dx = s_mirrors[right].center.x - pos.x;
+            if (nearest_dist_sq >= 0 && dx * dx > nearest_dist_sq) {
+                right = s_mirror_count;
+            }
+            else {
+                f32 dist_sq = get_distance_sq(pos, s_mirrors[right].center);
+                if (nearest_dist_sq < 0 || dist_sq < nearest_dist_sq) {
+                    nearest_dist_sq = dist_sq;
+                    nearest = right;
                 }
+                right++;
             }
-            // Translates the mirror plane according to the active animation and rotates it as well
-            if (active_ig != nullptr) {
-                mkb::mtxa_from_identity();
-                translation_factor.x = active_ig->position.x - ig_init_pos.x;
-                translation_factor.y = active_ig->position.y - ig_init_pos.y;
-                translation_factor.z = active_ig->position.z - ig_init_pos.z;
-
-                mkb::mtxa_translate(&mirror_origin);
-                mkb::mtxa_translate(&translation_factor);
-                mkb::mtxa_rotate_x(active_ig->rotation.x);
-                mkb::mtxa_rotate_y(active_ig->rotation.y);
-                mkb::mtxa_rotate_z(active_ig->rotation.z);
+        }
+        if (left >= 0) {
+            f32 dx = pos.x - s_mirrors[left].center.x;
+            if (nearest_dist_sq >= 0 && dx * dx > nearest_dist_sq) {
+                left = -1;
             }
+            else {
+                f32 dist_sq = get_distance_sq(pos, s_mirrors[left].center);
+                if (nearest_dist_sq < 0 || dist_sq < nearest_dist_sq) {
+                    nearest_dist_sq = dist_sq;
+                    nearest = left;
+                }
+                left--;
+            }
+        }
+    }
+    return nearest;
+}
+
+// The nearest mirror to any active ball, or -1 if there are none
+static s32 find_mirror_nearest_to_balls() {
+    s32 nearest = -1;
+    f32 nearest_dist_sq = 0;
+    mkb::Ball* ball = mkb::balls;
+    for (u32 idx = 0; idx < BALL_COUNT; idx++, ball++) {
+        if (ball->status != mkb::STAT_NORMAL) {
+            s_last_nearest[idx] = -1;
+            continue;
+        }
+
+        f32 dist_sq;
+        s_last_nearest[idx] = find_nearest_mirror(ball->pos, s_last_nearest[idx], dist_sq);
+        if (nearest == -1 || dist_sq < nearest_dist_sq) {
+            nearest = s_last_nearest[idx];
+            nearest_dist_sq = dist_sq;
         }
-        ball++;
     }
+    return nearest;
+}
+
+// Translates the mirror plane according to the active animation and rotates it as well.
+// The itemgroup's transform is T(position) * R(rotation) * T(-origin), computed by the game every frame, so
+// T(offset) * transform * T(origin) is T(center + position - origin) * R(rotation) without any trig of our own
+static void set_mirror_transform(const Mirror& mirror) {
+    mkb::Itemgroup* active_ig = &mkb::itemgroups[mirror.coli_header_idx];
+    Vec offset = mirror.offset;
+    Vec ig_origin = mkb::stagedef->coli_header_list[mirror.coli_header_idx].origin;
+
+    // Itemgroup is only packed to match the game's layout, transform is 4-byte aligned
+    static_assert(offsetof(mkb::Itemgroup, transform) % 4 == 0);
+    mkb::Mtx* transform = reinterpret_cast<mkb::Mtx*>(reinterpret_cast<u8*>(active_ig) +
+                                                      offsetof(mkb::Itemgroup, transform));
+
+    mkb::mtxa_from_translate(&offset);
+    mkb::mtxa_mult_right(transform);
+    mkb::mtxa_translate(&ig_origin);
+}
+
+// How large a mirror appears from a camera, proportional to its bounding sphere's area on screen. 0 if it's outside of
+// the view frustum, approximated by a cone around the view direction
+static f32 get_visibility(const Mirror& mirror, const mkb::Camera& camera, const Vec& forward) {
+    Vec to_mirror = {mirror.center.x - camera.pos.x, mirror.center.y - camera.pos.y, mirror.center.z - camera.pos.z};
+    f32 depth = to_mirror.x * forward.x + to_mirror.y * forward.y + to_mirror.z * forward.z;
+    if (depth < -mirror.radius || depth - mirror.radius > camera.far) return 0;
 
-    active_ig = nullptr;
-    nearest_dist_to_mir = -1.0;
-    return;
+    // Distance from the view direction, against the half width of the view at that depth, widened by the radius
+    f32 off_axis_sq = get_distance_sq(to_mirror, {0, 0, 0}) - depth * depth;
+    f32 aspect = camera.aspect > 1 ? camera.aspect : 1;
+    f32 half_width = (depth > 0 ? depth : 0) * camera.fov_tangent * aspect + mirror.radius;
+    if (off_axis_sq > half_width * half_width) return 0;
+
+    f32 near_depth = depth > camera.near ? depth : camera.near;
+    return mirror.radius * mirror.radius / (near_depth * near_depth);
+}
+
+// The most visible mirror from the camera currently being drawn, or -1 if none are in view
+static s32 find_most_visible_mirror() {
+    const mkb::Camera* camera = mkb::g_current_camera;
+
+    Vec forward = {camera->pivot.x - camera->pos.x, camera->pivot.y - camera->pos.y, camera->pivot.z - camera->pos.z};
+    f32 forward_len = mkb::math_sqrt(get_distance_sq(forward, {0, 0, 0}));
+    if (forward_len == 0) return -1;
+    forward.x /= forward_len;
+    forward.y /= forward_len;
+    forward.z /= forward_len;
+
+    s32 best = -1;
+    f32 best_visibility = 0;
+    for (u32 i = 0; i < s_mirror_count; i++) {
+        f32 visibility = get_visibility(s_mirrors[i], *camera, forward);
+        if (visibility > best_visibility) {
+            best = i;
+            best_visibility = visibility;
+        }
+    }
+    return best;
+}
+
+// Translates the most visible mirror from its origin to the current translation/rotation of its collision header.
+// The game renders a single reflection per camera, so only one mirror plane can be drawn at a time
+void mirror_tick() {
+    if (mkb::stagedef != s_indexed_stagedef || mkb::g_current_stage_id != s_indexed_stage_id) {
+        build_index();
+    }
+    if (s_mirror_count == 0) return;
+
+    s32 nearest = find_most_visible_mirror();
+    if (nearest == -1) {
+        nearest = find_mirror_nearest_to_balls();
+    }
+    if (nearest == -1) return;
+    set_mirror_transform(s_mirrors[nearest]);
 }
 
 // Hooks into the reflection-handling function, calling our function instead
 void init_main_loop() {
     patch::write_branch_bl(reinterpret_cast<void*>(0x8034b270), reinterpret_cast<void*>(mirror_tick));
     patch::write_nop(reinterpret_cast<void*>(0x8034b11c));
-    nearest_dist_to_mir = -1.0;
-    distance_to_mirror = 0.0;
-    active_ig = nullptr;
 }
 
 }// namespace extended_reflections
@@ -0,0 +1,170 @@
+#include "frame_time_monitor.h"
+
+#include "internal/draw.h"
+#include "internal/heap.h"
+#include "internal/pad.h"
+#include "internal/tickable.h"
+
+// Measures how long each frame takes, and counts frames which took long enough to drop a frame
+namespace frame_time_monitor {
+
+TICKABLE_DEFINITION((
+        .name = "frame-time-monitor",
+        .description = "Frame time monitor",
+        .init_main_loop = init_main_loop,
+        .disp = disp,
+        .tick = tick, ))
+
+static constexpr u32 RING_SIZE = 600;
+static constexpr u32 STAGE_COUNT = 421;
+static constexpr u32 SUB_MODE_COUNT = 256;
+
+// Frame durations are bucketed by whole milliseconds, the last bucket also holds anything longer
+static constexpr u32 HISTOGRAM_BUCKETS = 40;
+
+// Frames taking more than one and a half 60 Hz frames mean the game dropped a frame
+static constexpr u32 FRAME_US = 16683;
+static constexpr u32 LAG_US = FRAME_US * 3 / 2;
+
+static constexpr u32 GRAPH_WIDTH = 30;
+static constexpr s32 LINE_HEIGHT = 14;
+static constexpr s32 X = 16;
+
+static u32 s_ticks_per_ms;
+static mkb::OSTick s_last_frame_start;
+
+// Durations of the last RING_SIZE frames in microseconds, and a histogram of the same frames
+static u16 s_ring[RING_SIZE];
+static u32 s_ring_idx;
+static u16 s_histogram[HISTOGRAM_BUCKETS];
+
+static u32 s_lag_frames;
+// Allocated when enabled, as they're a little big to keep around otherwise
+static u16* s_stage_lag_frames;
+static u16* s_sub_mode_lag_frames;
+
+static bool s_show_graph;
+
+static u32 bucket(u16 duration_us) {
+    u32 ms = duration_us / 1000;
+    return ms < HISTOGRAM_BUCKETS ? ms : HISTOGRAM_BUCKETS - 1;
+}
+
+static void count_lag_frame() {
+    s_lag_frames++;
+
+    u32 stage_id = mkb::current_stage_id;
+    if (stage_id < STAGE_COUNT && s_stage_lag_frames[stage_id] < 0xffff) {
+        s_stage_lag_frames[stage_id]++;
+    }
+    u32 sub_mode = mkb::sub_mode;
+    if (sub_mode < SUB_MODE_COUNT && s_sub_mode_lag_frames[sub_mode] < 0xffff) {
+        s_sub_mode_lag_frames[sub_mode]++;
+    }
+}
+
+void init_main_loop() {
+    // The timebase runs at a quarter of the bus clock
+    s_ticks_per_ms = mkb::BUS_CLOCK_SPEED / 4 / 1000;
+    s_stage_lag_frames = static_cast<u16*>(heap::alloc(STAGE_COUNT * sizeof(u16)));
+    s_sub_mode_lag_frames = static_cast<u16*>(heap::alloc(SUB_MODE_COUNT * sizeof(u16)));
+}
+
+void on_frame_start() {
+    if (!active_tickable_ptr->enabled || !s_stage_lag_frames || !s_sub_mode_lag_frames) {
+        // Start timing afresh when enabled at runtime, rather than counting the time spent disabled as a lag frame
+        s_last_frame_start = 0;
+        return;
+    }
+
+    mkb::OSTick now = mkb::OSGetTick();
+    mkb::OSTick last = s_last_frame_start;
+    s_last_frame_start = now;
+    if (last == 0) return;
+
+    // Won't overflow unless a frame takes over ten seconds
+    u32 duration_us = (now - last) * 10 / (s_ticks_per_ms / 100);
+    u16 clamped_us = duration_us < 0xffff ? duration_us : 0xffff;
+
+    // Replace the oldest frame in the ring and the histogram
+    if (s_ring[s_ring_idx] != 0) {
+        s_histogram[bucket(s_ring[s_ring_idx])]--;
+    }
+    s_ring[s_ring_idx] = clamped_us;
+    s_histogram[bucket(clamped_us)]++;
+    s_ring_idx = (s_ring_idx + 1) % RING_SIZE;
+
+    if (duration_us > LAG_US) {
+        count_lag_frame();
+    }
+}
+
+static void report() {
+    mkb::OSReport("[wsmod] %d lag frames in total\n", s_lag_frames);
+    for (u32 i = 0; i < STAGE_COUNT; i++) {
+        if (s_stage_lag_frames[i] > 0) {
+            mkb::OSReport("[wsmod]  Stage %d: %d lag frames\n", i, s_stage_lag_frames[i]);
+        }
+    }
+    for (u32 i = 0; i < SUB_MODE_COUNT; i++) {
+        if (s_sub_mode_lag_frames[i] > 0) {
+            mkb::OSReport("[wsmod]  Sub mode %d: %d lag frames\n", i, s_sub_mode_lag_frames[i]);
+        }
+    }
+}
+
+void tick() {
+    if (!s_stage_lag_frames || !s_sub_mode_lag_frames) return;
+
+    // Z + D-pad Right toggles the histogram, Z + D-pad Down prints lag frames per stage and sub mode to the console
+    if (pad::button_chord_pressed(mkb::PAD_TRIGGER_Z, mkb::PAD_BUTTON_RIGHT)) {
+        s_show_graph = !s_show_graph;
+    }
+    if (pad::button_chord_pressed(mkb::PAD_TRIGGER_Z, mkb::PAD_BUTTON_DOWN)) {
+        report();
+    }
+}
+
+// Returns the y coordinate below the graph
+static s32 draw_graph(s32 y) {
+    u32 highest = 1;
+    for (u32 i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (s_histogram[i] > highest) highest = s_histogram[i];
+    }
+
+    static char s_bar[GRAPH_WIDTH + 1];
+    for (u32 i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (s_histogram[i] == 0) continue;
+
+        // Always draw at least one character, so rare long frames stand out
+        u32 width = s_histogram[i] * GRAPH_WIDTH / highest;
+        if (width == 0) width = 1;
+        mkb::memset(s_bar, '#', width);
+        s_bar[width] = '\0';
+
+        mkb::GXColor color = i * 1000 >= LAG_US ? draw::RED : draw::GREEN;
+        draw::debug_text(X, y, color, "%2d%s %s", i, i == HISTOGRAM_BUCKETS - 1 ? "+" : "ms", s_bar);
+        y += LINE_HEIGHT;
+    }
+    return y;
+}
+
+void disp() {
+    if (!s_stage_lag_frames || !s_sub_mode_lag_frames) return;
+
+    u32 stage_id = mkb::current_stage_id;
+    u32 stage_lag_frames = stage_id < STAGE_COUNT ? s_stage_lag_frames[stage_id] : 0;
+    u32 last_us = s_ring[(s_ring_idx + RING_SIZE - 1) % RING_SIZE];
+    mkb::GXColor color = last_us > LAG_US ? draw::RED : draw::WHITE;
+    s32 y = draw::begin_overlay();
+    draw::debug_text(X, y, color, "%2d.%dms Lag: %d (stage %d)", last_us / 1000, last_us / 100 % 10, s_lag_frames,
+                     stage_lag_frames);
+    y += LINE_HEIGHT;
+
+    if (s_show_graph) {
+        y = draw_graph(y);
+    }
+    draw::end_overlay(y);
+}
+
+}// namespace frame_time_monitor
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "mkb/mkb.h"
+
+namespace frame_time_monitor {
+
+void init_main_loop();
+void tick();
+void disp();
+
+// Call at the very start of each frame
+void on_frame_start();
+
+}// namespace frame_time_monitor
@@ -1,11 +1,10 @@
 #include "stage_author_names.h"
 
 #include "internal/heap.h"
-#include "internal/log.h"
 #include "internal/patch.h"
 #include "internal/tickable.h"
 #include "mkb/mkb.h"
-
+#include "utils/hashutil.h"
 
 // Allows for stage author names to be displayed under the stage name.
 namespace stage_author_names {
@@ -16,17 +15,186 @@ TICKABLE_DEFINITION((
         .init_main_loop = init_main_loop, ))
 
 static char author_file_path[] = "/stgname/authors.str";
+static char compiled_file_path[] = "/stgname/authors.bin";
 static char author_fallback_name = '\0';
-static char* author_file_buf = nullptr;
 static constexpr u16 STAGE_COUNT = 421;
-static char author_list[STAGE_COUNT][64];
+static constexpr u16 NO_AUTHOR = 0xffff;
+static constexpr u32 MAX_NAME_LENGTH = 127;// Longer names in authors.str are cut short
+
+// Each author's name is stored once in a pool of NUL-terminated strings, either built in place inside the loaded
+// authors.str or mapped straight out of authors.bin. Stages index into the pool, as many stages share an author.
+static char* author_pool = nullptr;
+static u16* author_offsets = nullptr;// STAGE_COUNT entries
+
+/*
+ * authors.bin, compiled offline from authors.str by script/compile-authors.py
+ */
+
+static constexpr u32 COMPILED_MAGIC = 0x57534155;// 'WSAU'
+static constexpr u16 COMPILED_VERSION = 3;
+
+struct CompiledHeader {
+    u32 magic;
+    u16 version;
+    u16 stage_count;
+    u32 size;
+    u32 checksum;   // FNV-1a of everything after the header
+    u32 text_length;// Of the authors.str it was compiled from, to catch stale files
+};
+static_assert(sizeof(CompiledHeader) == 20);
+
+// Open addressing table of pool offsets, only needed while the pool is being built
+static constexpr u32 INTERN_TABLE_SIZE = 512;// Power of two, larger than STAGE_COUNT
+
+static constexpr u32 NO_TEXT = 0xFFFFFFFF;// authors.str length when there's no authors.str to check against
+
+// Adds the `length` character name at `name` to the end of the pool unless it's already in it. `name` may overlap the
+// end of the pool, as long as it doesn't start before it. Returns the name's offset into the pool.
+static u16 intern_name(char* name, u32 length, u32& pool_length, u16* table) {
+    u32 slot = hashutil::fnv1a(name, length) & (INTERN_TABLE_SIZE - 1);
+    while (table[slot] != NO_AUTHOR) {
+        char* existing = author_pool + table[slot];
+        if (mkb::strncmp(existing, name, length) == 0 && existing[length] == '\0') return table[slot];
+        slot = (slot + 1) & (INTERN_TABLE_SIZE - 1);
+    }
+
+    u16 offset = pool_length;
+    mkb::memmove(author_pool + offset, name, length);
+    author_pool[offset + length] = '\0';
+    pool_length += length + 1;
+    table[slot] = offset;
+    return offset;
+}
+
+// Turns the author file in `buf` into the pool, one name per line. Each name is moved back over the lines before it,
+// so the pool never overtakes the text still to be read.
+static void build_author_pool(char* buf, u32 length, u16* offsets) {
+    u16 table[INTERN_TABLE_SIZE];
+    mkb::memset(table, 0xff, sizeof(table));
+    mkb::memset(offsets, 0xff, STAGE_COUNT * sizeof(u16));
+
+    author_pool = buf;
+    u32 pool_length = 0;
+    char* line = buf;
+    char* eof = buf + length;
+
+    // Stages past the end of a short file are left without an author
+    for (u16 stage_id = 0; stage_id < STAGE_COUNT && line < eof; stage_id++) {
+        char* name_end = line;
+        while (name_end < eof && *name_end != '\n') name_end++;
+        char* next_line = name_end + 1;
+        if (name_end > line && name_end[-1] == '\r') name_end--;
+
+        // A name ends at a NUL, just like it would when displayed
+        u32 name_length = 0;
+        while (name_length < MAX_NAME_LENGTH && line + name_length < name_end && line[name_length] != '\0') {
+            name_length++;
+        }
+        offsets[stage_id] = intern_name(line, name_length, pool_length, table);
+        line = next_line;
+    }
+}
+
+// Points the author table at a loaded authors.bin if it's valid, so it can be used as is.
+static bool map_compiled_authors(u8* blob, u32 blob_length, u32 text_length) {
+    const auto* header = reinterpret_cast<const CompiledHeader*>(blob);
+    if (blob_length < sizeof(CompiledHeader) || header->magic != COMPILED_MAGIC) return false;
+    if (header->version != COMPILED_VERSION) {
+        mkb::OSReport("[mod] authors.bin has version %d, expected %d\n", header->version, COMPILED_VERSION);
+        return false;
+    }
+
+    u32 pool_offset = sizeof(CompiledHeader) + STAGE_COUNT * sizeof(u16);
+    if (header->stage_count != STAGE_COUNT || header->size > blob_length || pool_offset > header->size ||
+        hashutil::fnv1a(blob + sizeof(CompiledHeader), header->size - sizeof(CompiledHeader)) != header->checksum) {
+        mkb::OSReport("[mod] authors.bin is corrupt\n");
+        return false;
+    }
+
+    // Names must start inside the pool, which ends in a terminator
+    u16* offsets = reinterpret_cast<u16*>(blob + sizeof(CompiledHeader));
+    for (u32 i = 0; i < STAGE_COUNT; i++) {
+        if (offsets[i] != NO_AUTHOR && (pool_offset + offsets[i] >= header->size || blob[header->size - 1] != '\0')) {
+            mkb::OSReport("[mod] authors.bin is corrupt\n");
+            return false;
+        }
+    }
+    if (text_length != NO_TEXT && header->text_length != text_length) {
+        mkb::OSReport("[mod] authors.bin is out of date, recompile it from authors.str\n");
+        return false;
+    }
+
+    author_offsets = offsets;
+    author_pool = reinterpret_cast<char*>(blob + pool_offset);
+    return true;
+}
+
+// Load authors.bin with a single read if there is one. Returns false if authors.str needs to be parsed instead.
+static bool load_compiled_authors(u32 text_length) {
+    mkb::DVDFileInfo file_info;
+    if (!mkb::DVDOpen(compiled_file_path, &file_info)) return false;
+
+    // heap::alloc returns 32-byte aligned memory, necessary for DVDReadPrio
+    s32 read_length = (file_info.length + 0x1f) & 0xffffffe0;
+    u8* blob = static_cast<u8*>(heap::alloc(read_length));
+    bool success = false;
+    if (blob && mkb::DVDReadPrio(&file_info, blob, read_length, 0, 2) > 0) {
+        success = map_compiled_authors(blob, file_info.length, text_length);
+    }
+    mkb::DVDClose(&file_info);
+
+    // The table and pool point into the blob, so it's only freed if it went unused
+    if (success) {
+        mkb::OSReport("[mod] Loaded compiled stage author list file\n");
+    }
+    else if (blob) {
+        heap::free(blob);
+    }
+    return success;
+}
+
+static void load_authors() {
+    // authors.bin is enough on its own, so it's tried even without an authors.str to check it against
+    mkb::DVDFileInfo author_file_info;
+    bool has_text = mkb::DVDOpen(author_file_path, &author_file_info);
+    if (load_compiled_authors(has_text ? author_file_info.length : NO_TEXT)) {
+        if (has_text) mkb::DVDClose(&author_file_info);
+        return;
+    }
+    if (!has_text) {
+        mkb::OSReport("[mod] Author name file (stgname/authors.str) failed to load from disc\n");
+        return;
+    }
+
+    // Round the length of the author file to a multiple of 32, necessary for DVDReadAsyncPrio.
+    // One more byte, so the last name can be NUL-terminated even without a trailing newline.
+    s32 read_length = (author_file_info.length + 1 + 0x1f) & 0xffffffe0;
+    char* author_file_buf = static_cast<char*>(heap::alloc(read_length));
+    u16* offsets = static_cast<u16*>(heap::alloc(STAGE_COUNT * sizeof(u16)));
+    bool read_success = author_file_buf && offsets &&
+                        mkb::read_entire_file_using_dvdread_prio_async(&author_file_info, author_file_buf,
+                                                                       read_length, 0) != 0;
+    mkb::DVDClose(&author_file_info);
+
+    if (!read_success) {
+        mkb::OSReport("[mod] Author name file (stgname/authors.str) failed to load from disc\n");
+        if (author_file_buf) heap::free(author_file_buf);
+        if (offsets) heap::free(offsets);
+        return;
+    }
+
+    mkb::OSReport("[mod] Now parsing stage author list file...\n");
+    build_author_pool(author_file_buf, author_file_info.length, offsets);
+    author_offsets = offsets;
+}
 
 void sprite_init(float x, float y) {
 
     char* author_name;
 
-    if (mkb::current_stage_id >= 0 && mkb::current_stage_id < STAGE_COUNT) {
-        author_name = author_list[mkb::current_stage_id];
+    if (author_offsets != nullptr && mkb::current_stage_id >= 0 && mkb::current_stage_id < STAGE_COUNT &&
+        author_offsets[mkb::current_stage_id] != NO_AUTHOR) {
+        author_name = author_pool + author_offsets[mkb::current_stage_id];
     }
     else {
         author_name = &author_fallback_name;
@@ -79,42 +247,8 @@ void sprite_init(float x, float y) {
 
 void init_main_loop() {
     // Read the author file. This should only be run once.
-    if (author_file_buf == nullptr) {
-        mkb::DVDFileInfo author_file_info;
-        int author_file_length = mkb::DVDOpen(author_file_path, &author_file_info);
-
-        MOD_ASSERT_MSG(author_file_length != 0,
-                       "Author name file (stgname/authors.str) failed to load from disc");
-
-        // Round the length of the author file to a multiple of 32, necessary for DVDReadAsyncPrio
-        author_file_length = (author_file_info.length + 0x1f) & 0xffffffe0;
-        author_file_buf = static_cast<char*>(heap::alloc(author_file_length));
-        author_file_length = mkb::read_entire_file_using_dvdread_prio_async(&author_file_info, author_file_buf,
-                                                                            author_file_length, 0);
-        char* eof = author_file_buf + author_file_info.length;
-
-        MOD_ASSERT_MSG(author_file_length != 0,
-                       "Author name file (stgname/authors.str) failed to load from disc");
-
-        mkb::OSReport("[mod] Now parsing stage author list file...\n");
-        u16 current_stage_id = 0;
-
-        do {
-            char name[128] = {0};
-            char* name_end = mkb::strchr(author_file_buf, '\n');
-            MOD_ASSERT_MSG(name_end != nullptr,
-                           "Author name author_file_buf ended unexpectedly, please ensure there are 421 lines in the author_file_buf");
-            MOD_ASSERT_MSG((name_end - author_file_buf) < 128,
-                           "Author name for a stage is greater than the limit of 127 characters");
-
-            mkb::strncpy(name, author_file_buf, (name_end - author_file_buf));
-
-            mkb::strcpy(author_list[current_stage_id], name);
-            current_stage_id++;
-            author_file_buf = name_end + 1;
-        } while (current_stage_id < STAGE_COUNT && author_file_buf <= eof);
-
-        mkb::DVDClose(&author_file_info);
+    if (author_offsets == nullptr) {
+        load_authors();
     }
 
     static patch::Tramp<decltype(&mkb::create_hud_stage_name_sprites)> s_stage_name_tramp;
@@ -2,6 +2,4 @@
 
 namespace fix_labyrinth_camera {
 
-void init_main_loop();
-
 }// namespace fix_labyrinth_camera
\ No newline at end of file
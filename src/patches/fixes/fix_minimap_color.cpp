@@ -6,14 +6,15 @@
 
 namespace fix_minimap_color {
 
+// Overwrite Baby's minimap color with pure white like the other monkeys.
+// Unchecked, as this is data rather than code, with no fixed original value to compare against
+static constexpr patch::TableEntry PATCHES[] = {
+    {0x80494494, 0, 0, 0x00ffffff},
+};
+
 TICKABLE_DEFINITION((
         .name = "fix-minimap-color",
         .description = "Minimap color fix",
-        .init_main_loop = init_main_loop, ))
-
-void init_main_loop() {
-    // Overwrite Baby's minimap color with pure white like the other monkeys
-    patch::write_word(reinterpret_cast<void*>(0x80494494), (0x00ffffff));
-}
+        .main_loop_patches = PATCHES, ))
 
 }// namespace fix_minimap_color
@@ -2,7 +2,6 @@
 
 namespace fix_minimap_color {
 
-void init_main_loop();
 void init_main_game();
 
 }// namespace fix_minimap_color
@@ -6,15 +6,16 @@
 
 namespace fix_revolution_slot {
 
+// Always return 'false' for a specific function that checks if the stage ID
+// is 348 when determining whether or not to handle level loading specially.
+// Unchecked, as the replaced instruction hasn't been verified against the game yet
+static constexpr patch::TableEntry PATCHES[] = {
+    {0x802ca9fc, 0, 0, PPC_INSTR_LI(PPC_R3, 0x0)},
+};
+
 TICKABLE_DEFINITION((
         .name = "fix-revolution-slot",
         .description = "Revolution stage slot fix",
-        .init_main_loop = init_main_loop, ))
-
-// Always return 'false' for a specific function that checks if the stage ID
-// is 348 when determining whether or not to handle level loading specially
-void init_main_loop() {
-    patch::write_word(reinterpret_cast<void*>(0x802ca9fc), PPC_INSTR_LI(PPC_R3, 0x0));
-}
+        .main_loop_patches = PATCHES, ))
 
 }// namespace fix_revolution_slot
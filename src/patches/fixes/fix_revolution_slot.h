@@ -2,6 +2,4 @@
 
 namespace fix_revolution_slot {
 
-void init_main_loop();
-
 }// namespace fix_revolution_slot
\ No newline at end of file
@@ -12,45 +12,43 @@ namespace fix_stobj_draw {
  * to 255.
  */
 
-TICKABLE_DEFINITION((
-        .name = "stobj-draw-fix",
-        .description = "Stobj draw fix patch",
-        .init_main_loop = init_main_loop, ))
+// Nop the `extsb` instr following an lbz to prevent sign extension. Takes the Ghidra address of the lbz
+static constexpr patch::TableEntry nop_extsb(u32 lbz_addr_lo) {
+    u32 ram_addr = lbz_addr_lo + 0x80240000 - 0x80199fa0 + 0x802701d8;
+    return {ram_addr + 4, 0x7c000774, 0xfc00fffe, 0x60000000};// extsb(.) rA, rS
+}
 
 // These are Ghidra addresses...
-static const u16 lbz_addrs_lo[] = {
-    0x0fb8,
-    0x0fb8,
-    0x0fcc,
-    0x1aa0,
-    0x1aa0,
-    0x1abc,
-    0x1abc,
-    0x1ce4,
-    0x1ce4,
-    0x1d08,
-    0x1d08,
-    0x1d34,
-    0x1d34,
-    0x3cf0,
-    0x4ea4,
-    0x4ecc,
-    0x4f64,
-    0x6500,
-    0x6570,
-    0x6a64,
-    0x7208,
-    0x7c5c,
-    0x7c98,
-    0x7d34,
+static constexpr patch::TableEntry PATCHES[] = {
+    nop_extsb(0x0fb8),
+    nop_extsb(0x0fb8),
+    nop_extsb(0x0fcc),
+    nop_extsb(0x1aa0),
+    nop_extsb(0x1aa0),
+    nop_extsb(0x1abc),
+    nop_extsb(0x1abc),
+    nop_extsb(0x1ce4),
+    nop_extsb(0x1ce4),
+    nop_extsb(0x1d08),
+    nop_extsb(0x1d08),
+    nop_extsb(0x1d34),
+    nop_extsb(0x1d34),
+    nop_extsb(0x3cf0),
+    nop_extsb(0x4ea4),
+    nop_extsb(0x4ecc),
+    nop_extsb(0x4f64),
+    nop_extsb(0x6500),
+    nop_extsb(0x6570),
+    nop_extsb(0x6a64),
+    nop_extsb(0x7208),
+    nop_extsb(0x7c5c),
+    nop_extsb(0x7c98),
+    nop_extsb(0x7d34),
 };
 
-void init_main_loop() {
-    for (u32 addr: lbz_addrs_lo) {
-        u32 ram_addr = addr + 0x80240000 - 0x80199fa0 + 0x802701d8;
-        // Nop `extsb` instr following lbz to prevent sign extension
-        patch::write_nop(reinterpret_cast<void*>(ram_addr + 4));
-    }
-}
+TICKABLE_DEFINITION((
+        .name = "stobj-draw-fix",
+        .description = "Stobj draw fix patch",
+        .main_loop_patches = PATCHES, ))
 
 }// namespace fix_stobj_draw
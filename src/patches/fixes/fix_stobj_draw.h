@@ -2,6 +2,4 @@
 
 namespace fix_stobj_draw {
 
-void init_main_loop();
-
 }// namespace fix_stobj_draw
\ No newline at end of file
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "mkb/mkb.h"
+
 namespace fix_widescreen {
 
-void init_main_loop();
+bool active_in(mkb::MainMode main_mode, mkb::SubMode sub_mode);
+void on_enter();
+void on_exit();
 void tick();
 
-}// namespace fix_widescreen
\ No newline at end of file
+}// namespace fix_widescreen
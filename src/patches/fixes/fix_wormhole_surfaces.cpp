@@ -6,15 +6,16 @@
 
 namespace fix_wormhole_surfaces {
 
+// Always return 'true' for a specific function that checks if the stage ID
+// belongs to a slot normally used for party games.
+// Unchecked, as the replaced instruction hasn't been verified against the game yet
+static constexpr patch::TableEntry PATCHES[] = {
+    {0x802c8ce4, 0, 0, PPC_INSTR_LI(PPC_R0, 0x1)},
+};
+
 TICKABLE_DEFINITION((
         .name = "fix-wormhole-surfaces",
         .description = "Party game stage slot fix",
-        .init_main_loop = init_main_loop, ))
-
-// Always return 'true' for a specific function that checks if the stage ID
-// belongs to a slot normally used for party games.
-void init_main_loop() {
-    patch::write_word(reinterpret_cast<void*>(0x802c8ce4), PPC_INSTR_LI(PPC_R0, 0x1));
-}
+        .main_loop_patches = PATCHES, ))
 
 }// namespace fix_wormhole_surfaces
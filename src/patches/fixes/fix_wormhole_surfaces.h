@@ -2,6 +2,4 @@
 
 namespace fix_wormhole_surfaces {
 
-void init_main_loop();
-
 }// namespace fix_wormhole_surfaces
\ No newline at end of file
@@ -11,9 +11,9 @@ TICKABLE_DEFINITION((
         .name = "fix-any-percent-crash",
         .description = "Story mode any-percent crash fix",
         .init_main_loop = init_main_loop,
-        .tick = tick, ))
+        .active_in = active_in,
+        .on_enter = on_enter, ))
 
-static bool chara_heap_cleared;
 static mkb::SpriteTex* texes[10] = {};
 static u8 active_sprite_idx = 0.;
 static patch::Tramp<decltype(&mkb::g_load_preview_texture)> tex_load_tramp;
@@ -38,21 +38,20 @@ void init_main_loop() {
                          });
 }
 
-// Frees the preview images to heap on the 'save data' screen.
-void tick() {
-    if (mkb::sub_mode == mkb::SMD_GAME_SUGG_SAVE_INIT) {
-        chara_heap_cleared = false;
-    }
+// Frees the preview images to heap once each time the 'save data' screen is entered. They're forgotten once freed, so
+// entering the screen again before more are loaded doesn't free them twice.
+bool active_in(mkb::MainMode main_mode, mkb::SubMode sub_mode) {
+    return sub_mode == mkb::SMD_GAME_SUGG_SAVE_MAIN;
+}
 
-    if (mkb::sub_mode == mkb::SMD_GAME_SUGG_SAVE_MAIN && !chara_heap_cleared) {
-        for (int i = 0; i < 10; i++) {
-            if (texes[i] != nullptr && texes[i]->tex_data != nullptr) {
-                mkb::OSFreeToHeap(mkb::chara_heap, texes[i]->tex_data);
-            }
+void on_enter() {
+    for (int i = 0; i < 10; i++) {
+        if (texes[i] != nullptr && texes[i]->tex_data != nullptr) {
+            mkb::OSFreeToHeap(mkb::chara_heap, texes[i]->tex_data);
         }
-
-        chara_heap_cleared = true;
+        texes[i] = nullptr;
     }
+    active_sprite_idx = 0;
 }
 
 }// namespace story_any_percent_fix
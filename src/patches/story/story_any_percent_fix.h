@@ -1,8 +1,11 @@
 #pragma once
 
+#include "mkb/mkb.h"
+
 namespace story_any_percent_fix {
 
 void init_main_loop();
-void tick();
+bool active_in(mkb::MainMode main_mode, mkb::SubMode sub_mode);
+void on_enter();
 
 }// namespace story_any_percent_fix
\ No newline at end of file
@@ -6,15 +6,16 @@
 
 namespace disable_tutorial {
 
+// Nops the sub_mode_frame_counter decrement in smd_adv_title_tick.
+// This ensures the tutorial sequence will never start.
+// Unchecked, as the decrement's encoding hasn't been verified against the game yet
+static constexpr patch::TableEntry PATCHES[] = {
+    {0x8027bbb0, 0, 0, PPC_INSTR_NOP()},
+};
+
 TICKABLE_DEFINITION((
         .name = "disable-how-to-play-screen",
         .description = "Tutorial sequence removal",
-        .init_main_loop = init_main_loop, ))
-
-// Nops the sub_mode_frame_counter decrement in smd_adv_title_tick.
-// This ensures the tutorial sequence will never start.
-void init_main_loop() {
-    patch::write_nop(reinterpret_cast<void*>(0x8027bbb0));
-}
+        .main_loop_patches = PATCHES, ))
 
 }// namespace disable_tutorial
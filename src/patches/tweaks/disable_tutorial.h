@@ -2,6 +2,4 @@
 
 namespace disable_tutorial {
 
-void init_main_loop();
-
 }// namespace disable_tutorial
\ No newline at end of file
@@ -10,7 +10,8 @@ TICKABLE_DEFINITION((
         .name = "no-hurry-up-music",
         .description = "Hurry up music removal",
         .init_main_game = init_main_game,
-        .tick = tick, ))
+        .active_in = active_in,
+        .on_enter = on_enter, ))
 
 // Nop out calls to start the hurry-up music. Call after main_game load
 void init_main_game() {
@@ -20,9 +21,11 @@ void init_main_game() {
 
 // The init function breaks the "Time Over" sound, as it checks to see if the
 // hurry up music is playing. This re-imlements the playing of the sound.
-void tick() {
-    if (mkb::sub_mode == mkb::SMD_GAME_TIMEOVER_INIT) {
-        mkb::g_SoftStreamStart_with_some_defaults_2(0x2c);
-    }
+bool active_in(mkb::MainMode main_mode, mkb::SubMode sub_mode) {
+    return sub_mode == mkb::SMD_GAME_TIMEOVER_INIT;
+}
+
+void on_enter() {
+    mkb::g_SoftStreamStart_with_some_defaults_2(0x2c);
 }
 }// namespace no_hurry_up_music
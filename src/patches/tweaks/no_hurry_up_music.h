@@ -1,8 +1,11 @@
 #pragma once
 
+#include "mkb/mkb.h"
+
 namespace no_hurry_up_music {
 
 void init_main_game();
-void tick();
+bool active_in(mkb::MainMode main_mode, mkb::SubMode sub_mode);
+void on_enter();
 
 }// namespace no_hurry_up_music
\ No newline at end of file
@@ -5,14 +5,14 @@
 
 namespace pause_volume_fix {
 
+// Nop a call to a function that decreases in-game volume on pause
+static constexpr patch::TableEntry PATCHES[] = {
+    {0x802a32a8, 0x48000001, 0xfc000003, 0x60000000},// bl
+};
+
 TICKABLE_DEFINITION((
         .name = "no-music-vol-decrease-on-pause",
         .description = "No music volume decrease on pause",
-        .init_main_loop = init_main_loop, ))
-
-// Nop a call to a function that decreases in-game volume on pause
-void init_main_loop() {
-    patch::write_nop(reinterpret_cast<void*>(0x802a32a8));
-}
+        .main_loop_patches = PATCHES, ))
 
 }// namespace pause_volume_fix
@@ -2,6 +2,4 @@
 
 namespace pause_volume_fix {
 
-void init_main_loop();
-
 }// namespace pause_volume_fix
\ No newline at end of file
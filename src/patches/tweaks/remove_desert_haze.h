@@ -2,6 +2,4 @@
 
 namespace remove_desert_haze {
 
-void init_main_loop();
-
 }// namespace remove_desert_haze
\ No newline at end of file
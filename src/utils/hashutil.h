@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../mkb/mkb.h"
+
+/*
+ * FNV-1a, for checksums of compiled files and hashing short strings. A hash can be continued over more data by
+ * passing the previous result as `hash`.
+ */
+
+namespace hashutil {
+
+static constexpr u32 FNV1A_INIT = 0x811C9DC5;
+
+inline u32 fnv1a(const void* data, u32 length, u32 hash = FNV1A_INIT) {
+    const u8* bytes = static_cast<const u8*>(data);
+    for (u32 i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 0x01000193;
+    }
+    return hash;
+}
+
+}// namespace hashutil
@@ -16,6 +16,19 @@
 
 #define PPC_INSTR_NOP() (0x60000000)
 
+#define PPC_INSTR_ADDI(dest_register, source_register, value) \
+    (0x38000000 + (((u32) (dest_register)) << 21) + (((u32) (source_register)) << 16) + ((u16) value))
+#define PPC_INSTR_ORI(dest_register, source_register, value) \
+    (0x60000000 + (((u32) (source_register)) << 21) + (((u32) (dest_register)) << 16) + ((u16) value))
+#define PPC_INSTR_LWZ(dest_register, offset, base_register) \
+    (0x80000000 + (((u32) (dest_register)) << 21) + (((u32) (base_register)) << 16) + ((u16) offset))
+#define PPC_INSTR_STW(source_register, offset, base_register) \
+    (0x90000000 + (((u32) (source_register)) << 21) + (((u32) (base_register)) << 16) + ((u16) offset))
+#define PPC_INSTR_STWU(source_register, offset, base_register) \
+    (0x94000000 + (((u32) (source_register)) << 21) + (((u32) (base_register)) << 16) + ((u16) offset))
+#define PPC_INSTR_MFLR(dest_register) (0x7C0802A6 + (((u32) (dest_register)) << 21))
+#define PPC_INSTR_MTLR(source_register) (0x7C0803A6 + (((u32) (source_register)) << 21))
+
 // TODO: PPC_INSR_CMPWI
 
 #define PPC_R0 0
@@ -0,0 +1,404 @@
+/*
+ * Conformance and throughput tests for the config parser (src/config/), fed through the real DVD reading code in
+ * config.cpp from in-memory files.
+ *
+ * Usage: config_test [path to default-config.txt] [path to the config.bin compiled from it for the host]
+ */
+
+#include "config/config.h"
+#include "internal/heap.h"
+#include "internal/tickable.h"
+#include "patches/custom/party_game_toggle.h"
+#include "shim/mkb_shim.h"
+#include <cstdio>
+#include <cstdlib>
+
+// bgm_id_lookup and theme_id_lookup from assembly.h, which can't be included here, as its namespace
+// clashes with main()
+extern "C" {
+extern u16 bgm_id_lookup[421];
+extern u16 theme_id_lookup[421];
+}
+
+namespace party_game_toggle {
+u16 party_game_bitflag;
+}
+
+static constexpr u32 HEAP_START = 0x80010000;
+static constexpr u32 HEAP_SIZE = 0x100000;
+static constexpr u32 STAGE_ID_COUNT = 421;
+
+static constexpr u32 MAX_TEXT_SIZE = 0x200000;
+static constexpr u32 SYNTHETIC_LINES = 10000;
+static constexpr u32 THROUGHPUT_RUNS = 20;
+
+// A few tickables from default-config.txt, with the same bounds as the real ones
+static tickable::Tickable s_skip_cutscenes = {.name = "skip-cutscenes"};
+static tickable::Tickable s_fix_widescreen = {.name = "fix-widescreen"};
+static tickable::Tickable s_custom_world_count = {
+    .name = "custom-world-count",
+    .active_value = 10,
+    .lower_bound = 1,
+    .upper_bound = 10,
+};
+static tickable::Tickable* const TICKABLES[] = {&s_skip_cutscenes, &s_fix_widescreen, &s_custom_world_count};
+
+// Everything parsing a config can change
+struct Result {
+    bool enabled[3];
+    int world_count;
+    u16 party_game_bitflag;
+    u16 theme_ids[STAGE_ID_COUNT];
+    u16 music_ids[STAGE_ID_COUNT];
+
+    bool operator==(const Result& other) const {
+        for (u32 i = 0; i < 3; i++) {
+            if (enabled[i] != other.enabled[i]) return false;
+        }
+        for (u32 i = 0; i < STAGE_ID_COUNT; i++) {
+            if (theme_ids[i] != other.theme_ids[i] || music_ids[i] != other.music_ids[i]) return false;
+        }
+        return world_count == other.world_count && party_game_bitflag == other.party_game_bitflag;
+    }
+};
+
+static Result get_result() {
+    Result result;
+    for (u32 i = 0; i < 3; i++) {
+        result.enabled[i] = TICKABLES[i]->enabled;
+    }
+    result.world_count = *s_custom_world_count.active_value;
+    result.party_game_bitflag = party_game_toggle::party_game_bitflag;
+    for (u32 i = 0; i < STAGE_ID_COUNT; i++) {
+        result.theme_ids[i] = theme_id_lookup[i];
+        result.music_ids[i] = bgm_id_lookup[i];
+    }
+    return result;
+}
+
+// Parse config.txt (and config.bin, if given) from scratch
+static Result parse(const char* text, u32 length, const void* blob = nullptr, u32 blob_length = 0) {
+    for (tickable::Tickable* tickable: TICKABLES) {
+        tickable->enabled = false;
+    }
+    s_custom_world_count.active_value = 10;
+    party_game_toggle::party_game_bitflag = 0;
+    for (u32 i = 0; i < STAGE_ID_COUNT; i++) {
+        theme_id_lookup[i] = 0;
+        bgm_id_lookup[i] = 0;
+    }
+
+    shim::set_dvd_file("/config.txt", text, length);
+    shim::set_dvd_file("/config.bin", blob, blob_length);
+    shim::clear_reports();
+    config::parse_config();
+    return get_result();
+}
+
+static u32 length_of(const char* str) {
+    u32 length = 0;
+    while (str[length] != '\0') length++;
+    return length;
+}
+
+static Result parse(const char* text) {
+    return parse(text, length_of(text));
+}
+
+// Problems found in config.txt are reported like "config.txt:12:3: Expected ..."
+static u32 count_errors() {
+    return shim::count_reports("config.txt:");
+}
+
+/*
+ * The shipped config, and the same config written differently
+ */
+
+static char s_default[MAX_TEXT_SIZE];
+static u32 s_default_length;
+static char s_variant[MAX_TEXT_SIZE];
+
+// Returns the file's length
+static u32 load_file(const char* path, void* buf) {
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file) {
+        std::fprintf(stderr, "Couldn't open %s\n", path);
+        std::exit(1);
+    }
+    u32 length = std::fread(buf, 1, MAX_TEXT_SIZE, file);
+    std::fclose(file);
+    CHECK(length > 0 && length < MAX_TEXT_SIZE);
+    return length;
+}
+
+static void test_default(Result& out) {
+    out = parse(s_default, s_default_length);
+
+    // Only REL patches the test doesn't know about are reported
+    CHECK(count_errors() == shim::count_reports("Unknown REL patch"));
+    CHECK(!out.enabled[0] && !out.enabled[1] && out.world_count == 10);
+    CHECK(out.party_game_bitflag == 0);
+
+    // Every stage gets a theme (music ID 0 is valid, so that can't be told apart from a missing entry)
+    for (u32 i = 1; i < STAGE_ID_COUNT; i++) {
+        CHECK(out.theme_ids[i] != 0);
+    }
+    CHECK(out.theme_ids[1] == 19 && out.theme_ids[420] == 32);
+    CHECK(out.music_ids[1] == 7 && out.music_ids[420] == 61);
+}
+
+static void test_crlf(const Result& expected) {
+    u32 length = 0;
+    for (u32 i = 0; i < s_default_length; i++) {
+        if (s_default[i] == '\n') s_variant[length++] = '\r';
+        s_variant[length++] = s_default[i];
+    }
+    Result result = parse(s_variant, length);
+    CHECK(result == expected);
+}
+
+static void test_spaces(const Result& expected) {
+    // Indent with spaces instead of tabs, and pad either side of the ':'
+    u32 length = 0;
+    for (u32 i = 0; i < s_default_length; i++) {
+        char c = s_default[i];
+        if (c == '\t') {
+            for (u32 j = 0; j < 4; j++) s_variant[length++] = ' ';
+        }
+        else if (c == ':') {
+            s_variant[length++] = ' ';
+            s_variant[length++] = ':';
+            s_variant[length++] = ' ';
+        }
+        else {
+            s_variant[length++] = c;
+        }
+    }
+    Result result = parse(s_variant, length);
+    CHECK(result == expected);
+}
+
+static void test_no_trailing_newline() {
+    Result result = parse("# Theme IDs {\n\tSTAGE 3: 42\n}\n# REL Patches {\n\tskip-cutscenes: enabled\n}");
+    CHECK(result.theme_ids[3] == 42 && result.enabled[0]);
+
+    result = parse("# REL Patches {\n\tskip-cutscenes: enabled");
+    CHECK(result.enabled[0]);
+}
+
+/*
+ * Malformed configs
+ */
+
+static void test_missing_braces() {
+    // Without an opening brace the section is a comment
+    Result result = parse("# Theme IDs\n\tSTAGE 1: 5\n}\n");
+    CHECK(result.theme_ids[1] == 0 && count_errors() == 0);
+
+    // Without a closing brace the next section's header is reported, and its entries land in the unclosed section
+    result = parse("# Theme IDs {\n\tSTAGE 1: 5\n# Music IDs {\n\tSTAGE 2: 9\n}\n# REL Patches {\n\tfix-widescreen: enabled\n}\n");
+    CHECK(shim::count_reports("config.txt:3:14: Expected ':' after key") == 1);
+    CHECK(result.theme_ids[1] == 5 && result.theme_ids[2] == 9 && result.music_ids[2] == 0);
+
+    // Sections after the stray closing brace are parsed normally
+    CHECK(result.enabled[1]);
+}
+
+static void test_errors() {
+    Result result = parse("# REL Patches {\n"
+                          "\tfix-widescreen\n"
+                          "\t: enabled\n"
+                          "\tskip-cutscenes:\n"
+                          "\tcustom-world-count: 11\n"
+                          "\tcustom-world-count: 0\n"
+                          "\tcustom-world-count: many\n"
+                          "\tfix-widescreen: 3\n"
+                          "\tno-such-patch: enabled\n"
+                          "}\n"
+                          "# Theme IDs {\n"
+                          "\tSTAGE 421: 1\n"
+                          "\tSTAGE -1: 1\n"
+                          "\tSTAGE 12 : x1\n"
+                          "\tSTAGE: 1\n"
+                          "}\n"
+                          "# Party Game Toggles {\n"
+                          "\tmonkey-chess: enabled\n"
+                          "\tmonkey-golf: yes\n"
+                          "}\n"
+                          "# Unknown Section {\n"
+                          "\tanything: goes\n"
+                          "}\n");
+
+    CHECK(shim::count_reports("config.txt:2:16: Expected ':' after key") == 1);
+    CHECK(shim::count_reports("config.txt:3:2: Expected a key before ':'") == 1);
+    CHECK(shim::count_reports("config.txt:4:17: Expected a value after ':'") == 1);
+    CHECK(shim::count_reports("config.txt:5:22: Passed value for patch larger than maximum value") == 1);
+    CHECK(shim::count_reports("config.txt:6:22: Passed value for patch smaller than minimum value") == 1);
+    CHECK(shim::count_reports("config.txt:7:22: Expected 'enabled', 'disabled' or a decimal integer") == 1);
+    CHECK(shim::count_reports("config.txt:8:18: REL patch doesn't take a value") == 1);
+    CHECK(shim::count_reports("config.txt:9:2: Unknown REL patch") == 1);
+    CHECK(shim::count_reports("config.txt:12:2: Stage ID out of range") == 1);
+    CHECK(shim::count_reports("config.txt:13:2: Stage ID out of range") == 1);
+    CHECK(shim::count_reports("config.txt:14:13: Expected a decimal integer") == 1);
+    CHECK(shim::count_reports("config.txt:15:2: Expected a key like 'STAGE 12'") == 1);
+    CHECK(shim::count_reports("config.txt:18:2: Unknown party game") == 1);
+    CHECK(shim::count_reports("config.txt:19:15: Expected 'enabled' or 'disabled'") == 1);
+    CHECK(shim::count_reports("Unknown category Unknown Section") == 1);
+    CHECK(count_errors() == 14);
+
+    // Nothing was applied
+    CHECK(!result.enabled[0] && !result.enabled[1] && result.world_count == 10);
+    CHECK(result.party_game_bitflag == 0 && result.theme_ids[12] == 0);
+}
+
+static void test_long_lines() {
+    // Lines are truncated to 127 characters, without swallowing the lines after them
+    static char s_text[1024];
+    u32 length = 0;
+    const char* start = "# Comment that goes on and on";
+    for (u32 i = 0; start[i] != '\0'; i++) s_text[length++] = start[i];
+    for (u32 i = 0; i < 600; i++) s_text[length++] = 'x';
+    const char* rest = "\n# Party Game Toggles {\n\tmonkey-golf: enabled\n}\n";
+    for (u32 i = 0; rest[i] != '\0'; i++) s_text[length++] = rest[i];
+
+    Result result = parse(s_text, length);
+    CHECK(result.party_game_bitflag == 0x20 && count_errors() == 0);
+}
+
+/*
+ * config.bin
+ */
+
+static u8 s_compiled[MAX_TEXT_SIZE];
+static u32 s_compiled_length;
+static u8 s_corrupt[MAX_TEXT_SIZE];
+
+static void test_compiled(const Result& expected) {
+    // The config.bin script/compile-config.py made from default-config.txt has the same effect as parsing it
+    Result result = parse(s_default, s_default_length, s_compiled, s_compiled_length);
+    CHECK(shim::count_reports("Loaded compiled config file") == 1);
+    CHECK(shim::count_reports("Now parsing config file") == 0);
+    CHECK(result == expected);
+
+    // config.bin is enough on its own
+    result = parse(nullptr, 0, s_compiled, s_compiled_length);
+    CHECK(shim::count_reports("Loaded compiled config file") == 1);
+    CHECK(result == expected);
+
+    // Editing config.txt changes its length, which makes config.bin stale
+    for (u32 i = 0; i < s_default_length; i++) s_variant[i] = s_default[i];
+    s_variant[s_default_length] = '\n';
+    result = parse(s_variant, s_default_length + 1, s_compiled, s_compiled_length);
+    CHECK(shim::count_reports("config.bin is out of date") == 1);
+    CHECK(shim::count_reports("Now parsing config file") == 1);
+    CHECK(result == expected);
+
+    for (u32 i = 0; i < s_compiled_length; i++) s_corrupt[i] = s_compiled[i];
+    s_corrupt[s_compiled_length / 2] ^= 1;
+    result = parse(s_default, s_default_length, s_corrupt, s_compiled_length);
+    CHECK(shim::count_reports("config.bin is corrupt") == 1);
+    CHECK(result == expected);
+
+    // A corrupt config.bin without a config.txt to fall back on changes nothing
+    result = parse(nullptr, 0, s_corrupt, s_compiled_length);
+    CHECK(shim::count_reports("config.bin is corrupt") == 1);
+    CHECK(!result.enabled[0] && result.world_count == 10 && result.theme_ids[1] == 0);
+}
+
+/*
+ * Long configs
+ */
+
+static u32 append(char* buf, u32 length, const char* format, u32 a, u32 b) {
+    s32 written = std::snprintf(buf + length, MAX_TEXT_SIZE - length, format, a, b);
+    CHECK(written >= 0 && length + written < MAX_TEXT_SIZE);
+    return length + written;
+}
+
+// A config of SYNTHETIC_LINES lines, assigning each stage's IDs several times over. Returns its length.
+static u32 make_synthetic(char* buf, Result& expected) {
+    for (u16& id: expected.theme_ids) id = 0;
+    for (u16& id: expected.music_ids) id = 0;
+
+    u32 length = 0;
+    u32 lines = 0;
+    length = append(buf, length, "# Comments before the first section are ignored %d %d\n", 0, 0);
+    lines++;
+    length = append(buf, length, "# REL Patches {\n\tskip-cutscenes: enabled\n\tcustom-world-count: %d\n}\n", 7, 0);
+    lines += 4;
+
+    while (lines + 6 < SYNTHETIC_LINES) {
+        length = append(buf, length, "# Theme IDs {\n", 0, 0);
+        lines++;
+        for (u32 i = 0; i < 200 && lines + 4 < SYNTHETIC_LINES; i++, lines++) {
+            u32 stage_id = (lines * 7) % STAGE_ID_COUNT;
+            u16 value = lines % 1000;
+            length = append(buf, length, "\tSTAGE %d: %d\n", stage_id, value);
+            expected.theme_ids[stage_id] = value;
+        }
+        length = append(buf, length, "}\n# Music IDs {\n", 0, 0);
+        lines += 2;
+        for (u32 i = 0; i < 200 && lines + 2 < SYNTHETIC_LINES; i++, lines++) {
+            u32 stage_id = (lines * 13) % STAGE_ID_COUNT;
+            u16 value = lines % 100;
+            length = append(buf, length, "    STAGE %d :%d\r\n", stage_id, value);
+            expected.music_ids[stage_id] = value;
+        }
+        length = append(buf, length, "}\n", 0, 0);
+        lines++;
+    }
+
+    expected.enabled[0] = true;
+    expected.enabled[1] = false;
+    expected.enabled[2] = false;
+    expected.world_count = 7;
+    expected.party_game_bitflag = 0;
+    return length;
+}
+
+static void test_synthetic() {
+    static Result s_expected;
+    u32 length = make_synthetic(s_variant, s_expected);
+
+    Result result = parse(s_variant, length);
+    CHECK(count_errors() == 0);
+    CHECK(result == s_expected);
+
+    mkb::OSTick start = mkb::OSGetTick();
+    for (u32 i = 0; i < THROUGHPUT_RUNS; i++) {
+        parse(s_variant, length);
+    }
+    mkb::OSTick ticks = mkb::OSGetTick() - start;
+
+    f32 us = static_cast<f32>(ticks) / (mkb::BUS_CLOCK_SPEED / 4 / 1000000) / THROUGHPUT_RUNS;
+    std::printf("Parsed %d lines (%d bytes) in %.0f us: %.1f MB/s\n", SYNTHETIC_LINES, length, us, length / us);
+}
+
+int main(int argc, char** argv) {
+    s_default_length = load_file(argc > 1 ? argv[1] : "../configs/default-config.txt", s_default);
+    s_compiled_length = load_file(argc > 2 ? argv[2] : "build/default-config.bin", s_compiled);
+
+    shim::map_memory(HEAP_START, HEAP_START + HEAP_SIZE);
+    heap::init();
+    u32 free_space = heap::get_free_space();
+    for (tickable::Tickable* tickable: TICKABLES) {
+        tickable::get_tickable_manager().push(tickable);
+    }
+    shim::set_echo_reports(false);
+
+    static Result s_default_result;
+    test_default(s_default_result);
+    test_crlf(s_default_result);
+    test_spaces(s_default_result);
+    test_no_trailing_newline();
+    test_missing_braces();
+    test_errors();
+    test_long_lines();
+    test_compiled(s_default_result);
+    test_synthetic();
+
+    // Every buffer the parser allocated was freed again
+    CHECK(heap::get_free_space() == free_space);
+    std::printf("Config tests passed\n");
+    return 0;
+}
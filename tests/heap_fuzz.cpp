@@ -0,0 +1,264 @@
+/*
+ * Fuzzes and benchmarks the mod heap (src/internal/heap.cpp) on the host.
+ *
+ * Random allocations and frees are checked against a list of what should be live. A copy of the game's first-fit
+ * allocator allocates from the same heap at the same time, as other mods sharing mkb::HeapInfo do. Every so often,
+ * every chunk in the heap is walked and every live allocation's contents are checked.
+ *
+ * Usage: heap_fuzz [seed]
+ */
+
+#include "internal/heap.h"
+#include "shim/mkb_shim.h"
+#include <cstdio>
+#include <cstdlib>
+
+using mkb::ChunkInfo;
+
+static constexpr u32 HEAP_START = 0x80010000;
+static constexpr u32 HEAP_SIZE = 0x100000;
+
+static constexpr u32 MAX_LIVE = 4000;
+static constexpr u32 FUZZ_OPS = 200000;
+static constexpr u32 VERIFY_INTERVAL = 997;
+
+static constexpr u32 BENCH_LIVE = 600;
+static constexpr u32 BENCH_OPS = 400000;
+
+static u32 s_rng_state = 12345;
+
+static u32 next_random() {
+    // xorshift32
+    s_rng_state ^= s_rng_state << 13;
+    s_rng_state ^= s_rng_state >> 17;
+    s_rng_state ^= s_rng_state << 5;
+    return s_rng_state;
+}
+
+// Mostly small allocations, some medium ones and the occasional large one
+static u32 rand_size() {
+    u32 r = next_random() % 100;
+    if (r < 60) return next_random() % 64;
+    if (r < 90) return next_random() % 512;
+    return next_random() % 8192;
+}
+
+/*
+ * The game's allocator, as other mods use it on the shared heap: first fit, used chunks pushed to the front of the
+ * used list, freed chunks merged back in with DLInsert.
+ */
+
+static ChunkInfo* extract_chunk(ChunkInfo* list, ChunkInfo* chunk) {
+    if (chunk->next) chunk->next->prev = chunk->prev;
+    if (!chunk->prev) return chunk->next;
+    chunk->prev->next = chunk->next;
+    return list;
+}
+
+static void* foreign_alloc(u32 size) {
+    mkb::HeapInfo& heap_info = heap::get_heap_info();
+    u32 chunk_size = mkb::OSRoundUp32B(size + sizeof(ChunkInfo));
+
+    ChunkInfo* chunk = heap_info.first_free;
+    while (chunk && chunk->size < chunk_size) chunk = chunk->next;
+    if (!chunk) return nullptr;
+
+    u32 leftover = chunk->size - chunk_size;
+    if (leftover < 64) {
+        heap_info.first_free = extract_chunk(heap_info.first_free, chunk);
+    }
+    else {
+        chunk->size = chunk_size;
+        ChunkInfo* rest = reinterpret_cast<ChunkInfo*>(reinterpret_cast<u32>(chunk) + chunk_size);
+        rest->size = leftover;
+        rest->prev = chunk->prev;
+        rest->next = chunk->next;
+        if (rest->next) rest->next->prev = rest;
+        if (rest->prev) {
+            rest->prev->next = rest;
+        }
+        else {
+            heap_info.first_free = rest;
+        }
+    }
+
+    chunk->next = heap_info.first_used;
+    chunk->prev = nullptr;
+    if (heap_info.first_used) heap_info.first_used->prev = chunk;
+    heap_info.first_used = chunk;
+
+    void* ptr = reinterpret_cast<void*>(reinterpret_cast<u32>(chunk) + sizeof(ChunkInfo));
+    mkb::memset(ptr, 0, size);
+    return ptr;
+}
+
+static bool in_list(ChunkInfo* list, ChunkInfo* chunk) {
+    for (; list; list = list->next) {
+        if (list == chunk) return true;
+    }
+    return false;
+}
+
+static bool foreign_free(void* ptr) {
+    mkb::HeapInfo& heap_info = heap::get_heap_info();
+    ChunkInfo* chunk = reinterpret_cast<ChunkInfo*>(reinterpret_cast<u32>(ptr) - sizeof(ChunkInfo));
+    if (!in_list(heap_info.first_used, chunk)) return false;
+
+    heap_info.first_used = extract_chunk(heap_info.first_used, chunk);
+    heap_info.first_free = mkb::DLInsert(heap_info.first_free, chunk);
+    return true;
+}
+
+/*
+ * Fuzzing
+ */
+
+struct Allocation {
+    u8* ptr;
+    u32 size;
+    u8 pattern;
+    bool foreign;
+};
+
+static Allocation s_live[MAX_LIVE];
+static u32 s_live_count;
+
+static void check_lists(ChunkInfo* list) {
+    ChunkInfo* prev = nullptr;
+    for (ChunkInfo* chunk = list; chunk; chunk = chunk->next) {
+        CHECK(chunk->prev == prev);
+        prev = chunk;
+    }
+}
+
+static void verify() {
+    mkb::HeapInfo& heap_info = heap::get_heap_info();
+    check_lists(heap_info.first_free);
+    check_lists(heap_info.first_used);
+
+    // Chunks tile the heap, each one either free or used
+    u32 addr = HEAP_START;
+    while (addr < HEAP_START + HEAP_SIZE) {
+        ChunkInfo* chunk = reinterpret_cast<ChunkInfo*>(addr);
+        CHECK(chunk->size >= sizeof(ChunkInfo) && chunk->size % 32 == 0);
+        CHECK(in_list(heap_info.first_free, chunk) != in_list(heap_info.first_used, chunk));
+        addr += chunk->size;
+    }
+    CHECK(addr == HEAP_START + HEAP_SIZE);
+
+    for (u32 i = 0; i < s_live_count; i++) {
+        for (u32 j = 0; j < s_live[i].size; j++) {
+            CHECK(s_live[i].ptr[j] == s_live[i].pattern);
+        }
+    }
+}
+
+static void free_allocation(u32 idx) {
+    Allocation allocation = s_live[idx];
+    for (u32 j = 0; j < allocation.size; j++) {
+        CHECK(allocation.ptr[j] == allocation.pattern);
+    }
+    CHECK(allocation.foreign ? foreign_free(allocation.ptr) : heap::free(allocation.ptr));
+    s_live[idx] = s_live[--s_live_count];
+
+    // Double frees are rejected
+    if (!allocation.foreign && next_random() % 8 == 0) {
+        CHECK(!heap::free(allocation.ptr));
+    }
+}
+
+static void fuzz(bool with_foreign) {
+    for (u32 op = 0; op < FUZZ_OPS; op++) {
+        bool foreign = with_foreign && next_random() % 4 == 0;
+        if (next_random() % 100 < 52 && s_live_count < MAX_LIVE) {
+            u32 size = rand_size();
+            u8* ptr = static_cast<u8*>(foreign ? foreign_alloc(size) : heap::alloc(size));
+            if (ptr) {
+                // Memory comes back zeroed
+                for (u32 j = 0; j < size; j++) {
+                    CHECK(ptr[j] == 0);
+                }
+                u8 pattern = next_random();
+                mkb::memset(ptr, pattern, size);
+                s_live[s_live_count++] = {ptr, size, pattern, foreign};
+            }
+        }
+        else if (s_live_count > 0) {
+            free_allocation(next_random() % s_live_count);
+        }
+
+        // Pointers which were never allocated are rejected
+        if (next_random() % 16 == 0) {
+            CHECK(!heap::free(reinterpret_cast<void*>(HEAP_START + (next_random() % HEAP_SIZE | 4))));
+            CHECK(!heap::free(reinterpret_cast<void*>(HEAP_START + HEAP_SIZE + 0x40)));
+        }
+
+        if (op % VERIFY_INTERVAL == 0) verify();
+    }
+
+    while (s_live_count > 0) {
+        free_allocation(s_live_count - 1);
+    }
+    verify();
+    CHECK(heap::check_integrity());
+
+    // Everything merged back into one free chunk
+    mkb::HeapInfo& heap_info = heap::get_heap_info();
+    CHECK(heap_info.first_used == nullptr);
+    CHECK(heap_info.first_free && heap_info.first_free->size == HEAP_SIZE && !heap_info.first_free->next);
+#ifdef HEAP_INSTRUMENT
+    CHECK(heap::get_used_space() == 0);
+#endif
+}
+
+/*
+ * Benchmarking
+ */
+
+static f32 ticks_to_ns(u32 ticks) {
+    return static_cast<f32>(ticks) * 1000 / (mkb::BUS_CLOCK_SPEED / 4 / 1000000);
+}
+
+// Replaces random allocations in a heap that's partly full, like the mod does while running
+static void bench_steady_state() {
+    static void* s_slots[BENCH_LIVE];
+    for (void*& slot: s_slots) slot = heap::alloc(rand_size());
+
+    mkb::OSTick start = mkb::OSGetTick();
+    for (u32 i = 0; i < BENCH_OPS; i++) {
+        void*& slot = s_slots[next_random() % BENCH_LIVE];
+        if (slot) heap::free(slot);
+        slot = heap::alloc(rand_size());
+    }
+    f32 ns = ticks_to_ns(mkb::OSGetTick() - start);
+
+    for (void* slot: s_slots) {
+        if (slot) heap::free(slot);
+    }
+    std::printf("Steady state: %.1f ns per free and alloc\n", ns / BENCH_OPS);
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) s_rng_state = std::strtoul(argv[1], nullptr, 0);
+
+    shim::map_memory(HEAP_START, HEAP_START + HEAP_SIZE);
+    heap::init();
+    CHECK(heap::get_total_space() == HEAP_SIZE);
+
+    fuzz(true);
+    std::printf("Fuzzed %d operations alongside the game's allocator\n", FUZZ_OPS);
+    fuzz(false);
+    std::printf("Fuzzed %d operations\n", FUZZ_OPS);
+
+    bench_steady_state();
+#ifdef HEAP_INSTRUMENT
+    // The trace holds the fuzzer's first allocations here, rather than the mod's
+    u32 used_space = heap::get_used_space();
+    u32 peak_used_space = heap::get_peak_used_space();
+    heap::run_benchmark();
+    verify();
+    CHECK(heap::get_used_space() == used_space);
+    CHECK(heap::get_peak_used_space() == peak_used_space);
+#endif
+    return 0;
+}
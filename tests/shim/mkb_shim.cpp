@@ -0,0 +1,245 @@
+#include "mkb_shim.h"
+
+#include "internal/assembly.h"
+#include "internal/draw.h"
+#include "internal/relutil.h"
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <sys/mman.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+namespace shim {
+
+static u32 s_heap_end;
+
+void map_memory(u32 heap_start, u32 heap_end) {
+    void* mem = mmap(reinterpret_cast<void*>(MEM1_START), MEM1_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (mem != reinterpret_cast<void*>(MEM1_START)) {
+        std::fprintf(stderr, "Couldn't map main memory at 0x%08x\n", MEM1_START);
+        std::exit(1);
+    }
+
+    // The arena start heap::init() reads, as set by the game
+    *reinterpret_cast<u32*>(0x8000452C) = heap_start;
+    s_heap_end = heap_end;
+}
+
+static constexpr u32 REPORT_CAPACITY = 0x40000;
+static char s_reports[REPORT_CAPACITY];
+static u32 s_reports_length;
+static bool s_echo_reports = true;
+
+void set_echo_reports(bool echo) {
+    s_echo_reports = echo;
+}
+
+void clear_reports() {
+    s_reports_length = 0;
+}
+
+static bool matches_at(const char* str, const char* text) {
+    for (; *text != '\0'; str++, text++) {
+        if (*str != *text) return false;
+    }
+    return true;
+}
+
+u32 count_reports(const char* text) {
+    s_reports[s_reports_length] = '\0';
+    u32 count = 0;
+    for (u32 i = 0; i < s_reports_length; i++) {
+        if (matches_at(s_reports + i, text)) count++;
+    }
+    return count;
+}
+
+static void add_report(const char* format, std::va_list args) {
+    u32 space = REPORT_CAPACITY - 1 - s_reports_length;
+    s32 length = std::vsnprintf(s_reports + s_reports_length, space + 1, format, args);
+    CHECK(length >= 0 && static_cast<u32>(length) <= space);
+    if (s_echo_reports) std::fputs(s_reports + s_reports_length, stdout);
+    s_reports_length += length;
+}
+
+struct DvdFile {
+    const char* path;
+    const u8* data;
+    u32 length;
+};
+
+static constexpr u32 MAX_DVD_FILES = 8;
+static DvdFile s_dvd_files[MAX_DVD_FILES];
+
+static bool same_path(const char* a, const char* b) {
+    return matches_at(a, b) && matches_at(b, a);
+}
+
+void set_dvd_file(const char* path, const void* data, u32 length) {
+    DvdFile* free_slot = nullptr;
+    for (DvdFile& file: s_dvd_files) {
+        if (file.path && same_path(file.path, path)) {
+            file.path = nullptr;
+        }
+        if (!file.path && !free_slot) free_slot = &file;
+    }
+    if (!data) return;
+
+    CHECK(free_slot);
+    *free_slot = {path, static_cast<const u8*>(data), length};
+}
+
+static const DvdFile* get_dvd_file(const mkb::DVDFileInfo* file_info) {
+    // DVDOpen() stores which file it opened in place of its disc address
+    CHECK(file_info->startAddr < MAX_DVD_FILES && s_dvd_files[file_info->startAddr].path);
+    return &s_dvd_files[file_info->startAddr];
+}
+
+void check_failed(const char* file, int line, const char* exp) {
+    std::fprintf(stderr, "%s:%d: Check failed: %s\n", file, line, exp);
+    std::exit(1);
+}
+
+}// namespace shim
+
+namespace relutil {
+
+void* compute_mainloop_reldata_boundary() {
+    return reinterpret_cast<void*>(shim::s_heap_end);
+}
+
+// No RELs are ever loaded
+void* compute_rel_sections_end(void* module) {
+    return module;
+}
+
+}// namespace relutil
+
+// Nothing is drawn in host tests
+namespace draw {
+
+const mkb::GXColor RED = {0xfd, 0x68, 0x75, 0xff};
+
+void notify(mkb::GXColor color, char* format, ...) {}
+
+}// namespace draw
+
+// Only branched to from hooks, which host tests never install
+namespace main {
+
+void instruction_hook_common() {
+    std::abort();
+}
+
+}// namespace main
+
+// The game's C library functions (memset, strcmp, ...) are extern "C", so the host's C library provides them
+namespace mkb {
+
+MainMode main_mode;
+SubMode sub_mode;
+
+// The tickable manager hooks these, but host tests never call them
+void draw_debugtext() {}
+void load_additional_rel(char* rel_filepath, RelBufferInfo* rel_buffer_ptrs) {}
+
+// Host caches are coherent
+void DCFlushRange(void* startAddr, u32 nBytes) {}
+void ICInvalidateRange(void* startAddr, u32 nBytes) {}
+
+// The Gekko's bus clock. The timebase OSGetTick() reads runs at a quarter of it.
+undefined4 BUS_CLOCK_SPEED = 162000000;
+
+OSTick OSGetTick() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t ns = static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+    return static_cast<OSTick>(ns * (BUS_CLOCK_SPEED / 4 / 1000) / 1000000);
+}
+
+void OSReport(char* msg, ...) {
+    std::va_list args;
+    va_start(args, msg);
+    shim::add_report(msg, args);
+    va_end(args);
+}
+
+void OSPanic(char* file, int line, char* msg, ...) {
+    std::fprintf(stderr, "%s:%d: Panic: %s\n", file, line, msg);
+    std::exit(1);
+}
+
+BOOL32 DVDOpen(char* fileName, DVDFileInfo* fileInfo) {
+    for (u32 i = 0; i < shim::MAX_DVD_FILES; i++) {
+        const shim::DvdFile& file = shim::s_dvd_files[i];
+        if (file.path && shim::same_path(file.path, fileName)) {
+            fileInfo->startAddr = i;
+            fileInfo->length = file.length;
+            return true;
+        }
+    }
+    return false;
+}
+
+BOOL32 DVDClose(DVDFileInfo* fileInfo) {
+    shim::get_dvd_file(fileInfo);
+    return true;
+}
+
+// Like on the console, reads must be to 32-byte aligned memory, and their lengths multiples of 32 bytes. Bytes past
+// the end of the file read as zero.
+s32 DVDReadPrio(DVDFileInfo* fileInfo, void* addr, s32 length, s32 offset, s32 prio) {
+    const shim::DvdFile* file = shim::get_dvd_file(fileInfo);
+    CHECK(reinterpret_cast<u32>(addr) % 32 == 0 && length % 32 == 0 && offset % 4 == 0);
+    CHECK(offset >= 0 && static_cast<u32>(offset) <= file->length);
+
+    u8* dest = static_cast<u8*>(addr);
+    for (s32 i = 0; i < length; i++) {
+        u32 pos = offset + i;
+        dest[i] = pos < file->length ? file->data[pos] : 0;
+    }
+    return length;
+}
+
+u32 read_entire_file_using_dvdread_prio_async(DVDFileInfo* fileInfo, void* addr, s32 length, s32 offset) {
+    return DVDReadPrio(fileInfo, addr, length, offset, 2);
+}
+
+// Like the game's: inserts a chunk into an address-ordered list, merging it with the chunks either side of it if
+// they're adjacent in memory
+ChunkInfo* DLInsert(ChunkInfo* list, ChunkInfo* chunk) {
+    ChunkInfo* prev = nullptr;
+    ChunkInfo* next = list;
+    while (next && next < chunk) {
+        prev = next;
+        next = next->next;
+    }
+
+    chunk->next = next;
+    chunk->prev = prev;
+    if (next) {
+        next->prev = chunk;
+        if (reinterpret_cast<u32>(chunk) + chunk->size == reinterpret_cast<u32>(next)) {
+            chunk->size += next->size;
+            chunk->next = next->next;
+            if (chunk->next) chunk->next->prev = chunk;
+        }
+    }
+    if (!prev) return chunk;
+
+    prev->next = chunk;
+    if (reinterpret_cast<u32>(prev) + prev->size == reinterpret_cast<u32>(chunk)) {
+        prev->size += chunk->size;
+        prev->next = chunk->next;
+        if (prev->next) prev->next->prev = prev;
+    }
+    return list;
+}
+
+}// namespace mkb
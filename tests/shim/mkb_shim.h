@@ -0,0 +1,38 @@
+#pragma once
+
+/*
+ * Stand-ins for the parts of the game and the OS which mod code built into host tests calls into, implemented on
+ * top of the C library.
+ */
+
+#include "mkb/mkb.h"
+
+namespace shim {
+
+// Main memory is mapped at the same address as on the console, so code which checks for pointers into it works
+// unchanged
+static constexpr u32 MEM1_START = 0x80000000;
+static constexpr u32 MEM1_SIZE = 0x01800000;
+
+// Maps main memory and makes heap::init() span [heap_start, heap_end). Exits if the address range is taken.
+void map_memory(u32 heap_start, u32 heap_end);
+
+// Everything passed to OSReport is kept, and printed unless echoing is turned off
+void set_echo_reports(bool echo);
+void clear_reports();
+// How many times `text` appears in what's been reported since the last clear_reports()
+u32 count_reports(const char* text);
+
+// Makes DVDOpen() find a file at `path` with the given contents, which must outlive its use. Replaces any file
+// already at `path`, or removes it if `data` is nullptr.
+void set_dvd_file(const char* path, const void* data, u32 length);
+
+[[noreturn]] void check_failed(const char* file, int line, const char* exp);
+
+}// namespace shim
+
+// Stops the test with a message if `exp` is false. Unlike assert(), never compiled out.
+#define CHECK(exp)                                              \
+    ({                                                          \
+        if (!(exp)) shim::check_failed(__FILE__, __LINE__, #exp); \
+    })